@@ -6,7 +6,10 @@
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -32,6 +35,7 @@
 #define STA_BSY 0x80  /* Busy. */
 #define STA_DRDY 0x40 /* Device Ready. */
 #define STA_DRQ 0x08  /* Data Request. */
+#define STA_ERR 0x01  /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04 /* Software Reset. */
@@ -47,6 +51,47 @@
 #define CMD_IDENTIFY_DEVICE 0xec	/* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20	/* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30 /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4		/* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5		/* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6	/* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8			/* READ DMA. */
+#define CMD_WRITE_DMA 0xca			/* WRITE DMA. */
+
+/* Bus master IDE (BMDMA) registers, relative to a channel's
+   bus master base port.  See the Intel PIIX datasheet. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)	 /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)	 /* PRD table. */
+
+/* Bus master command and status register bits. */
+#define BM_CMD_START 0x01  /* Start/stop bus master transfer. */
+#define BM_CMD_READ 0x08   /* 1=device to memory, 0=memory to device. */
+#define BM_STA_ERROR 0x02  /* Transfer failed (write 1 to clear). */
+#define BM_STA_INTR 0x04   /* Device raised its interrupt (write 1 to clear). */
+
+/* A Physical Region Descriptor: one physically contiguous piece
+   of a DMA buffer.  A region may not cross a 64 kB boundary and a
+   size of 0 means 64 kB. */
+struct prd
+{
+	uint32_t addr;	/* Physical base address. */
+	uint16_t size;	/* Byte count. */
+	uint16_t flags; /* PRD_EOT on the last entry. */
+};
+#define PRD_EOT 0x8000
+#define PRD_CNT (PGSIZE / sizeof(struct prd))
+
+/* PCI configuration space access, used to find the IDE
+   controller's bus master registers. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+#define PCI_CLASS_IDE 0x0101 /* Mass storage, IDE controller. */
+#define PCI_CMD_IO 0x0001	 /* I/O space enable. */
+#define PCI_CMD_MASTER 0x0004 /* Bus master enable. */
+
+/* Largest number of sectors a single command can transfer.
+   A sector count register value of 0 means 256. */
+#define MAX_SECTORS_PER_CMD 256
 
 /* An ATA device. */
 struct disk
@@ -57,6 +102,9 @@ struct disk
 
 	bool is_ata;			/* 1=This device is an ATA disk. */
 	disk_sector_t capacity; /* Capacity in sectors (if is_ata). */
+	int multiple;			/* Sectors per interrupt for READ/WRITE
+							   MULTIPLE, 0 if not supported. */
+	bool dma;				/* Use bus master DMA for transfers. */
 
 	long long read_cnt;	 /* Number of sectors read. */
 	long long write_cnt; /* Number of sectors written. */
@@ -75,9 +123,48 @@ struct channel
 										 any interrupt would be spurious. */
 	struct semaphore completion_wait; /* Up'd by interrupt handler. */
 
+	uint16_t bm_base;  /* Bus master base port, 0 if no DMA. */
+	struct prd *prdt; /* PRD table for DMA transfers. */
+
+	/* Request queue, served by the channel's I/O thread. */
+	struct lock queue_lock;		 /* Protects the members below. */
+	struct condition queue_cond; /* Signaled when a request arrives. */
+	struct list queue;			 /* Pending requests, sorted by disk and sector. */
+	struct list fifo;			 /* Pending requests, in arrival order. */
+	int head_dev;				 /* Disk and sector right after the last */
+	disk_sector_t head_sec;		 /*   batch, for C-LOOK. */
+	long long merge_cnt;		 /* Requests merged into another one. */
+
 	struct disk devices[2]; /* The devices on this channel. */
 };
 
+/* A run of consecutive sectors on one disk, gathered from one or
+   more requests that are issued to the disk together. */
+struct disk_batch
+{
+	struct disk *disk;
+	disk_sector_t sec_no; /* First sector. */
+	size_t cnt;			  /* Number of sectors. */
+	bool write;
+	struct list reqs; /* Requests, in sector order. */
+};
+
+/* Position within the buffers of a list of requests. */
+struct xfer_cursor
+{
+	struct list *reqs;
+	struct list_elem *req; /* Current request. */
+	size_t ofs;			   /* Byte offset within its buffer. */
+};
+
+/* Deadline scheduler: ticks a request may wait before it is served
+   ahead of the elevator order. */
+#define READ_EXPIRE (TIMER_FREQ / 2)
+#define WRITE_EXPIRE (TIMER_FREQ * 5)
+
+/* -iosched: request scheduling policy. */
+enum disk_sched_policy disk_sched_policy = DISK_SCHED_CLOOK;
+
 /* We support the two "legacy" ATA channels found in a standard PC. */
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
@@ -85,11 +172,19 @@ static struct channel channels[CHANNEL_CNT];
 static void reset_channel(struct channel *);
 static bool check_device_type(struct disk *);
 static void identify_ata_device(struct disk *);
+static void set_multiple_mode(struct disk *, int sectors);
 
-static void select_sector(struct disk *, disk_sector_t);
+static void select_sector(struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command(struct channel *, uint8_t command);
 static void input_sector(struct channel *, void *);
 static void output_sector(struct channel *, const void *);
+static void pio_transfer(struct disk *, disk_sector_t, struct xfer_cursor *,
+						 size_t cnt, bool write);
+static void dma_transfer(struct disk *, disk_sector_t *, struct xfer_cursor *,
+						 size_t *cnt, bool write);
+static void disk_transfer(struct disk *, disk_sector_t, struct xfer_cursor *,
+						  size_t cnt, bool write);
+static uint16_t find_bus_master(void);
 
 static void wait_until_idle(const struct disk *);
 static bool wait_while_busy(const struct disk *);
@@ -98,10 +193,18 @@ static void select_device_wait(const struct disk *);
 
 static void interrupt_handler(struct intr_frame *);
 
+static void disk_io_sync(struct disk *, disk_sector_t, void *, size_t cnt,
+						 bool write);
+static bool request_less(const struct list_elem *, const struct list_elem *,
+						 void *aux);
+static void io_thread(void *channel);
+static void cursor_init(struct xfer_cursor *, struct list *reqs);
+
 /* Initialize the disk subsystem and detect disks. */
 void disk_init(void)
 {
 	size_t chan_no;
+	uint16_t bm_base = find_bus_master();
 
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
 	{
@@ -126,6 +229,21 @@ void disk_init(void)
 		lock_init(&c->lock);
 		c->expecting_interrupt = false;
 		sema_init(&c->completion_wait, 0);
+		lock_init(&c->queue_lock);
+		cond_init(&c->queue_cond);
+		list_init(&c->queue);
+		list_init(&c->fifo);
+		c->head_dev = 0;
+		c->head_sec = 0;
+		c->merge_cnt = 0;
+		c->bm_base = 0;
+		c->prdt = NULL;
+		if (bm_base != 0)
+		{
+			c->prdt = palloc_get_page(0);
+			if (c->prdt != NULL)
+				c->bm_base = bm_base + chan_no * 8;
+		}
 
 		/* Initialize devices. */
 		for (dev_no = 0; dev_no < 2; dev_no++)
@@ -137,6 +255,8 @@ void disk_init(void)
 
 			d->is_ata = false;
 			d->capacity = 0;
+			d->multiple = 0;
+			d->dma = false;
 
 			d->read_cnt = d->write_cnt = 0;
 		}
@@ -155,6 +275,10 @@ void disk_init(void)
 		for (dev_no = 0; dev_no < 2; dev_no++)
 			if (c->devices[dev_no].is_ata)
 				identify_ata_device(&c->devices[dev_no]);
+
+		/* From now on all transfers go through the request queue. */
+		if (thread_create(c->name, PRI_MAX, io_thread, c) == TID_ERROR)
+			PANIC("%s: can't start I/O thread", c->name);
 	}
 
 	/* DO NOT MODIFY BELOW LINES. */
@@ -174,9 +298,11 @@ void disk_print_stats(void)
 		{
 			struct disk *d = disk_get(chan_no, dev_no);
 			if (d != NULL && d->is_ata)
-				printf("%s: %lld reads, %lld writes\n",
-					   d->name, d->read_cnt, d->write_cnt);
+				printf("%s: %lld reads, %lld writes (%s)\n",
+					   d->name, d->read_cnt, d->write_cnt, d->dma ? "DMA" : "PIO");
 		}
+		if (channels[chan_no].merge_cnt > 0)
+			printf("hd%d: %lld requests merged\n", chan_no, channels[chan_no].merge_cnt);
 	}
 }
 
@@ -213,27 +339,22 @@ disk_size(struct disk *d)
 	return d->capacity;
 }
 
+/* Returns the name of disk D, e.g. "hd1:1". */
+const char *
+disk_name(struct disk *d)
+{
+	ASSERT(d != NULL);
+
+	return d->name;
+}
+
 /* Reads sector SEC_NO from disk D into BUFFER, which must have
    room for DISK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 void disk_read(struct disk *d, disk_sector_t sec_no, void *buffer)
 {
-	struct channel *c;
-
-	ASSERT(d != NULL);
-	ASSERT(buffer != NULL);
-
-	c = d->channel;
-	lock_acquire(&c->lock);
-	select_sector(d, sec_no);
-	issue_pio_command(c, CMD_READ_SECTOR_RETRY);
-	sema_down(&c->completion_wait);
-	if (!wait_while_busy(d))
-		PANIC("%s: disk read failed, sector=%" PRDSNu, d->name, sec_no);
-	input_sector(c, buffer);
-	d->read_cnt++;
-	lock_release(&c->lock);
+	disk_read_multiple(d, sec_no, buffer, 1);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -243,21 +364,473 @@ void disk_read(struct disk *d, disk_sector_t sec_no, void *buffer)
    per-disk locking is unneeded. */
 void disk_write(struct disk *d, disk_sector_t sec_no, const void *buffer)
 {
-	struct channel *c;
+	disk_write_multiple(d, sec_no, buffer, 1);
+}
 
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D
+   into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes.  Up to MAX_SECTORS_PER_CMD sectors are moved by each
+   ATA command.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void disk_read_multiple(struct disk *d, disk_sector_t sec_no, void *buffer,
+						size_t cnt)
+{
+	disk_io_sync(d, sec_no, buffer, cnt, false);
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D
+   from BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void disk_write_multiple(struct disk *d, disk_sector_t sec_no,
+						 const void *buffer, size_t cnt)
+{
+	disk_io_sync(d, sec_no, (void *)buffer, cnt, true);
+}
+
+/* Initializes REQ to move CNT sectors between disk D, starting at
+   SEC_NO, and BUFFER.  DONE, if non-null, is called with REQ once
+   the transfer has finished; AUX is left in REQ->aux for it.
+   BUFFER must be kernel memory: the transfer runs in the channel's
+   I/O thread, where no process's user pages are mapped. */
+void disk_request_init(struct disk_request *req, struct disk *d,
+					   disk_sector_t sec_no, void *buffer, size_t cnt,
+					   bool write, disk_done_func *done, void *aux)
+{
 	ASSERT(d != NULL);
 	ASSERT(buffer != NULL);
+	ASSERT(is_kernel_vaddr(buffer));
+	ASSERT(cnt > 0);
+
+	req->disk = d;
+	req->sec_no = sec_no;
+	req->buffer = buffer;
+	req->cnt = cnt;
+	req->write = write;
+	req->done = done;
+	req->aux = aux;
+}
 
-	c = d->channel;
-	lock_acquire(&c->lock);
-	select_sector(d, sec_no);
-	issue_pio_command(c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy(d))
-		PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sec_no);
-	output_sector(c, buffer);
-	sema_down(&c->completion_wait);
-	d->write_cnt++;
-	lock_release(&c->lock);
+/* Queues REQ on its disk's channel and returns immediately.  The
+   channel's I/O thread performs the transfer, possibly merged with
+   adjacent requests, in the order chosen by disk_sched_policy, and
+   then calls REQ->done.  REQ and its buffer must stay valid until
+   then.  Overlapping requests may complete in any order.
+
+   REQ->done runs in the I/O thread, so it must not wait for disk
+   I/O itself. */
+void disk_submit(struct disk_request *req)
+{
+	disk_submit_many(&req, 1);
+}
+
+/* Queues the CNT requests in REQS like disk_submit(), all before
+   the I/O threads get to look at them, so that requests for
+   adjacent sectors are merged into one transfer. */
+void disk_submit_many(struct disk_request **reqs, size_t cnt)
+{
+	size_t chan_no, i;
+
+	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+	{
+		struct channel *c = &channels[chan_no];
+		bool queued = false;
+
+		lock_acquire(&c->queue_lock);
+		for (i = 0; i < cnt; i++)
+		{
+			struct disk_request *req = reqs[i];
+			if (req->disk->channel != c)
+				continue;
+
+			ASSERT(req->sec_no < req->disk->capacity);
+			ASSERT(req->cnt <= req->disk->capacity - req->sec_no);
+
+			req->deadline = timer_ticks() + (req->write ? WRITE_EXPIRE : READ_EXPIRE);
+			list_insert_ordered(&c->queue, &req->elem, request_less, NULL);
+			list_push_back(&c->fifo, &req->fifo_elem);
+			queued = true;
+		}
+		if (queued)
+			cond_signal(&c->queue_cond, &c->queue_lock);
+		lock_release(&c->queue_lock);
+	}
+}
+
+/* disk_done_func for synchronous requests: wakes up the
+   submitter sleeping on the semaphore in REQ->aux. */
+static void
+wake_submitter(struct disk_request *req)
+{
+	sema_up(req->aux);
+}
+
+/* Submits a request and waits for it to complete. */
+static void
+disk_io_sync(struct disk *d, disk_sector_t sec_no, void *buffer, size_t cnt,
+			 bool write)
+{
+	struct disk_request req;
+	struct semaphore done;
+
+	sema_init(&done, 0);
+	disk_request_init(&req, d, sec_no, buffer, cnt, write, wake_submitter, &done);
+	disk_submit(&req);
+	sema_down(&done);
+}
+
+/* Sort key of a queued request: the disk, then the sector. */
+static bool
+request_less(const struct list_elem *a_, const struct list_elem *b_,
+			 void *aux UNUSED)
+{
+	const struct disk_request *a = list_entry(a_, struct disk_request, elem);
+	const struct disk_request *b = list_entry(b_, struct disk_request, elem);
+
+	if (a->disk != b->disk)
+		return a->disk->dev_no < b->disk->dev_no;
+	return a->sec_no < b->sec_no;
+}
+
+/* Returns true if request R can be issued right after the batch
+   ending at sector END of disk D in direction WRITE with CNT
+   sectors, without making the batch bigger than one command. */
+static bool
+can_merge(const struct disk_request *r, struct disk *d, bool write,
+		  size_t cnt)
+{
+	return r->disk == d && r->write == write && cnt + r->cnt <= MAX_SECTORS_PER_CMD;
+}
+
+/* Picks the next request of channel C according to
+   disk_sched_policy.  C's queue must not be empty and C's
+   queue_lock must be held. */
+static struct disk_request *
+pick_request(struct channel *c)
+{
+	struct list_elem *e;
+
+	if (disk_sched_policy == DISK_SCHED_DEADLINE)
+	{
+		/* Serve the oldest request first once it has waited too long. */
+		struct disk_request *oldest = list_entry(list_front(&c->fifo),
+												 struct disk_request, fifo_elem);
+		if (timer_ticks() >= oldest->deadline)
+			return oldest;
+	}
+
+	/* C-LOOK: the first request at or beyond the head position,
+	   wrapping around to the lowest one. */
+	for (e = list_begin(&c->queue); e != list_end(&c->queue); e = list_next(e))
+	{
+		struct disk_request *r = list_entry(e, struct disk_request, elem);
+		if (r->disk->dev_no > c->head_dev || (r->disk->dev_no == c->head_dev && r->sec_no >= c->head_sec))
+			return r;
+	}
+	return list_entry(list_front(&c->queue), struct disk_request, elem);
+}
+
+/* Removes R from channel C's queues. */
+static void
+dequeue_request(struct disk_request *r)
+{
+	list_remove(&r->elem);
+	list_remove(&r->fifo_elem);
+}
+
+/* Takes the next request off channel C's queue, plus any queued
+   requests for the sectors right before and after it, and puts
+   them in sector order into BATCH.  C's queue_lock must be held. */
+static void
+pick_batch(struct channel *c, struct disk_batch *batch)
+{
+	struct disk_request *first = pick_request(c);
+	struct list_elem *prev = list_prev(&first->elem);
+	struct list_elem *next = list_next(&first->elem);
+
+	dequeue_request(first);
+	list_init(&batch->reqs);
+	list_push_back(&batch->reqs, &first->elem);
+	batch->disk = first->disk;
+	batch->write = first->write;
+	batch->sec_no = first->sec_no;
+	batch->cnt = first->cnt;
+
+	/* Merge requests that continue the batch. */
+	while (next != list_end(&c->queue))
+	{
+		struct disk_request *r = list_entry(next, struct disk_request, elem);
+		if (r->sec_no != batch->sec_no + batch->cnt || !can_merge(r, batch->disk, batch->write, batch->cnt))
+			break;
+		next = list_next(next);
+		dequeue_request(r);
+		list_push_back(&batch->reqs, &r->elem);
+		batch->cnt += r->cnt;
+	}
+
+	/* Merge requests that end where the batch begins. */
+	while (prev != list_rend(&c->queue))
+	{
+		struct disk_request *r = list_entry(prev, struct disk_request, elem);
+		if (r->sec_no + r->cnt != batch->sec_no || !can_merge(r, batch->disk, batch->write, batch->cnt))
+			break;
+		prev = list_prev(prev);
+		dequeue_request(r);
+		list_push_front(&batch->reqs, &r->elem);
+		batch->sec_no = r->sec_no;
+		batch->cnt += r->cnt;
+	}
+
+	c->head_dev = batch->disk->dev_no;
+	c->head_sec = batch->sec_no + batch->cnt;
+	if (list_size(&batch->reqs) > 1)
+		c->merge_cnt += list_size(&batch->reqs) - 1;
+}
+
+/* Channel I/O thread: serves C's request queue forever. */
+static void
+io_thread(void *c_)
+{
+	struct channel *c = c_;
+
+	for (;;)
+	{
+		struct disk_batch batch;
+		struct xfer_cursor cur;
+
+		lock_acquire(&c->queue_lock);
+		while (list_empty(&c->queue))
+			cond_wait(&c->queue_cond, &c->queue_lock);
+		pick_batch(c, &batch);
+		lock_release(&c->queue_lock);
+
+		cursor_init(&cur, &batch.reqs);
+		lock_acquire(&c->lock);
+		disk_transfer(batch.disk, batch.sec_no, &cur, batch.cnt, batch.write);
+		lock_release(&c->lock);
+
+		/* The submitter may free a request as soon as its callback
+		   runs, so unlink it first. */
+		while (!list_empty(&batch.reqs))
+		{
+			struct disk_request *r = list_entry(list_pop_front(&batch.reqs),
+												struct disk_request, elem);
+			if (r->done != NULL)
+				r->done(r);
+		}
+	}
+}
+
+/* Sets CUR to the start of the first buffer in REQS. */
+static void
+cursor_init(struct xfer_cursor *cur, struct list *reqs)
+{
+	cur->reqs = reqs;
+	cur->req = list_begin(reqs);
+	cur->ofs = 0;
+}
+
+/* Returns the address of the next buffer byte at CUR and stores in
+   *LEN how many bytes, at most MAX, are contiguous from there, then
+   advances CUR past them. */
+static uint8_t *
+cursor_take(struct xfer_cursor *cur, size_t max, size_t *len)
+{
+	struct disk_request *r = list_entry(cur->req, struct disk_request, elem);
+	size_t left = r->cnt * DISK_SECTOR_SIZE - cur->ofs;
+	uint8_t *p = (uint8_t *)r->buffer + cur->ofs;
+
+	ASSERT(cur->req != list_end(cur->reqs));
+
+	*len = left < max ? left : max;
+	cur->ofs += *len;
+	if (cur->ofs == r->cnt * DISK_SECTOR_SIZE)
+	{
+		cur->req = list_next(cur->req);
+		cur->ofs = 0;
+	}
+	return p;
+}
+
+/* Moves CNT sectors between disk D, starting at SEC_NO, and the
+   buffers at CUR, by DMA when D supports it and the buffers are
+   reachable by the bus master, otherwise by PIO.  A disk whose DMA
+   transfer fails is switched to PIO for good.  D's channel lock
+   must be held. */
+static void
+disk_transfer(struct disk *d, disk_sector_t sec_no, struct xfer_cursor *cur,
+			  size_t cnt, bool write)
+{
+	if (d->dma)
+		dma_transfer(d, &sec_no, cur, &cnt, write);
+	if (cnt > 0)
+		pio_transfer(d, sec_no, cur, cnt, write);
+}
+
+/* Fills channel C's PRD table to describe the next LEN bytes of
+   the buffers at CUR.  Returns false if some buffer cannot be
+   reached by the bus master (not in the kernel's physical memory
+   map, above 4 GB, or too fragmented). */
+static bool
+build_prdt(struct channel *c, struct xfer_cursor *cur, size_t len)
+{
+	size_t i = 0;
+
+	while (len > 0)
+	{
+		size_t piece;
+		uint8_t *p = cursor_take(cur, len, &piece);
+		uint64_t pa;
+
+		if (!is_kernel_vaddr(p))
+			return false;
+		pa = vtop(p);
+		if (pa + piece > UINT32_MAX)
+			return false;
+		len -= piece;
+
+		/* The kernel maps physical memory linearly, so each piece is
+		   physically contiguous; only split it at 64 kB boundaries. */
+		while (piece > 0)
+		{
+			size_t chunk = 0x10000 - (pa & 0xffff);
+			if (chunk > piece)
+				chunk = piece;
+			if (i >= PRD_CNT)
+				return false;
+
+			c->prdt[i].addr = pa;
+			c->prdt[i].size = chunk & 0xffff;
+			c->prdt[i].flags = 0;
+			i++;
+			pa += chunk;
+			piece -= chunk;
+		}
+	}
+	c->prdt[i - 1].flags = PRD_EOT;
+	return true;
+}
+
+/* Moves up to *CNT sectors between disk D, starting at *SEC_NO,
+   and the buffers at CUR with bus master DMA.  The calling thread
+   sleeps until each completion interrupt, so the CPU is free
+   during the transfer.  Advances *SEC_NO, *CNT and CUR past what
+   was moved; stops early, leaving the rest for PIO, if a buffer is
+   not DMA-able or the controller reports an error, in which case
+   D falls back to PIO.  D's channel lock must be held. */
+static void
+dma_transfer(struct disk *d, disk_sector_t *sec_no, struct xfer_cursor *cur,
+			 size_t *cnt, bool write)
+{
+	struct channel *c = d->channel;
+
+	while (*cnt > 0)
+	{
+		size_t cmd_cnt = *cnt < MAX_SECTORS_PER_CMD ? *cnt : MAX_SECTORS_PER_CMD;
+		struct xfer_cursor start = *cur;
+		uint8_t bm_status, status;
+
+		if (!build_prdt(c, cur, cmd_cnt * DISK_SECTOR_SIZE))
+		{
+			*cur = start;
+			return;
+		}
+
+		/* Program the bus master: PRD table, direction, and clear
+		   any stale error/interrupt status. */
+		outb(reg_bm_command(c), write ? 0 : BM_CMD_READ);
+		outl(reg_bm_prdt(c), vtop(c->prdt));
+		outb(reg_bm_status(c), BM_STA_ERROR | BM_STA_INTR);
+
+		select_sector(d, *sec_no, cmd_cnt);
+		issue_pio_command(c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+		outb(reg_bm_command(c), (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+
+		sema_down(&c->completion_wait);
+
+		outb(reg_bm_command(c), write ? 0 : BM_CMD_READ);
+		bm_status = inb(reg_bm_status(c));
+		outb(reg_bm_status(c), BM_STA_ERROR | BM_STA_INTR);
+		status = inb(reg_alt_status(c));
+		if ((bm_status & BM_STA_ERROR) || (status & STA_ERR))
+		{
+			printf("%s: DMA %s failed, sector=%" PRDSNu ", using PIO\n",
+				   d->name, write ? "write" : "read", *sec_no);
+			d->dma = false;
+			*cur = start;
+			return;
+		}
+
+		if (write)
+			d->write_cnt += cmd_cnt;
+		else
+			d->read_cnt += cmd_cnt;
+		*sec_no += cmd_cnt;
+		*cnt -= cmd_cnt;
+	}
+}
+
+/* Moves CNT sectors between disk D, starting at SEC_NO, and the
+   buffers at CUR in PIO mode.  Each command covers up to
+   MAX_SECTORS_PER_CMD sectors.  When the disk supports READ/WRITE
+   MULTIPLE, one interrupt is taken per D->multiple sectors instead
+   of one per sector.  D's channel lock must be held. */
+static void
+pio_transfer(struct disk *d, disk_sector_t sec_no, struct xfer_cursor *cur,
+			 size_t cnt, bool write)
+{
+	struct channel *c = d->channel;
+
+	while (cnt > 0)
+	{
+		size_t cmd_cnt = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+		size_t block = d->multiple > 0 ? (size_t)d->multiple : 1;
+		size_t done;
+
+		select_sector(d, sec_no, cmd_cnt);
+		if (write)
+			issue_pio_command(c, d->multiple > 0 ? CMD_WRITE_MULTIPLE
+												 : CMD_WRITE_SECTOR_RETRY);
+		else
+			issue_pio_command(c, d->multiple > 0 ? CMD_READ_MULTIPLE
+												 : CMD_READ_SECTOR_RETRY);
+
+		/* The device asks for (or hands over) one DRQ block of
+		   BLOCK sectors per interrupt; the last one may be short. */
+		for (done = 0; done < cmd_cnt; done += block)
+		{
+			size_t n = cmd_cnt - done < block ? cmd_cnt - done : block;
+			size_t i;
+
+			if (!write)
+				sema_down(&c->completion_wait);
+			if (!wait_while_busy(d))
+				PANIC("%s: disk %s failed, sector=%" PRDSNu, d->name,
+					  write ? "write" : "read", sec_no + (disk_sector_t)done);
+			for (i = 0; i < n; i++)
+			{
+				size_t len;
+				uint8_t *sector = cursor_take(cur, DISK_SECTOR_SIZE, &len);
+
+				ASSERT(len == DISK_SECTOR_SIZE);
+				if (write)
+					output_sector(c, sector);
+				else
+					input_sector(c, sector);
+			}
+			if (write)
+				sema_down(&c->completion_wait);
+		}
+
+		if (write)
+			d->write_cnt += cmd_cnt;
+		else
+			d->read_cnt += cmd_cnt;
+		sec_no += cmd_cnt;
+		cnt -= cmd_cnt;
+	}
 }
 
 /* Disk detection and identification. */
@@ -382,6 +955,15 @@ identify_ata_device(struct disk *d)
 	/* Calculate capacity. */
 	d->capacity = id[60] | ((uint32_t)id[61] << 16);
 
+	/* Word 47 holds the largest DRQ block READ/WRITE MULTIPLE
+	   can use.  Turn multiple mode on with that block size. */
+	if ((id[47] & 0xff) > 1)
+		set_multiple_mode(d, id[47] & 0xff);
+
+	/* Word 49 bit 8: DMA supported.  Use it if the channel has a
+	   bus master. */
+	d->dma = c->bm_base != 0 && (id[49] & (1 << 8)) != 0;
+
 	/* Print identification message. */
 	printf("%s: detected %'" PRDSNu " sector (", d->name, d->capacity);
 	if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -400,6 +982,75 @@ identify_ata_device(struct disk *d)
 	printf("\"\n");
 }
 
+/* Sends a SET MULTIPLE MODE command so that READ/WRITE MULTIPLE
+   move SECTORS sectors per interrupt.  Leaves D->multiple at 0 if
+   the device rejects it. */
+static void
+set_multiple_mode(struct disk *d, int sectors)
+{
+	struct channel *c = d->channel;
+
+	select_device_wait(d);
+	outb(reg_nsect(c), sectors);
+	issue_pio_command(c, CMD_SET_MULTIPLE_MODE);
+	sema_down(&c->completion_wait);
+	wait_while_busy(d);
+	if ((inb(reg_alt_status(c)) & STA_ERR) == 0)
+		d->multiple = sectors;
+}
+
+/* Reads the 32-bit register at offset REG of PCI function
+   BUS:DEV.FUNC's configuration space. */
+static uint32_t
+pci_read_config(int bus, int dev, int func, int reg)
+{
+	outl(PCI_CONFIG_ADDR, 0x80000000u | (bus << 16) | (dev << 11) | (func << 8) | (reg & 0xfc));
+	return inl(PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to the 32-bit register at offset REG of PCI
+   function BUS:DEV.FUNC's configuration space. */
+static void
+pci_write_config(int bus, int dev, int func, int reg, uint32_t value)
+{
+	outl(PCI_CONFIG_ADDR, 0x80000000u | (bus << 16) | (dev << 11) | (func << 8) | (reg & 0xfc));
+	outl(PCI_CONFIG_DATA, value);
+}
+
+/* Looks for an IDE controller on PCI bus 0 that can act as a bus
+   master (such as QEMU's PIIX3), enables bus mastering on it, and
+   returns the I/O port base of its bus master registers (BAR4).
+   Returns 0 if there is none, in which case disks use PIO. */
+static uint16_t
+find_bus_master(void)
+{
+	int dev, func;
+
+	for (dev = 0; dev < 32; dev++)
+		for (func = 0; func < 8; func++)
+		{
+			uint32_t id = pci_read_config(0, dev, func, 0x00);
+			uint32_t class, bar4, cmd;
+
+			if ((id & 0xffff) == 0xffff)
+			{
+				if (func == 0)
+					break;
+				continue;
+			}
+
+			class = pci_read_config(0, dev, func, 0x08);
+			bar4 = pci_read_config(0, dev, func, 0x20);
+			if ((class >> 16) != PCI_CLASS_IDE || (class & 0x8000) == 0 || (bar4 & 1) == 0)
+				continue;
+
+			cmd = pci_read_config(0, dev, func, 0x04);
+			pci_write_config(0, dev, func, 0x04, (cmd & 0xffff) | PCI_CMD_IO | PCI_CMD_MASTER);
+			return bar4 & 0xfffc;
+		}
+	return 0;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -422,18 +1073,20 @@ print_ata_string(char *string, size_t size)
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.) */
 static void
-select_sector(struct disk *d, disk_sector_t sec_no)
+select_sector(struct disk *d, disk_sector_t sec_no, size_t cnt)
 {
 	struct channel *c = d->channel;
 
+	ASSERT(cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
 	ASSERT(sec_no < d->capacity);
-	ASSERT(sec_no < (1UL << 28));
+	ASSERT(cnt <= d->capacity - sec_no);
+	ASSERT(sec_no + cnt <= (1UL << 28));
 
 	select_device_wait(d);
-	outb(reg_nsect(c), 1);
+	outb(reg_nsect(c), cnt == MAX_SECTORS_PER_CMD ? 0 : cnt);
 	outb(reg_lbal(c), sec_no);
 	outb(reg_lbam(c), sec_no >> 8);
 	outb(reg_lbah(c), (sec_no >> 16));
@@ -6,7 +6,9 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -21,6 +23,15 @@ struct inode_disk
 	uint32_t unused[125]; /* Not used. */
 };
 
+/* Number of zero sectors inode_create() writes per disk command. */
+#define ZERO_CHUNK_SECTORS 8
+
+/* Sectors of a user buffer read or written per disk command.  The
+ * disk is driven from its channel's I/O thread, which does not run
+ * in the caller's address space, so user memory goes through a
+ * kernel page of this many sectors. */
+#define USER_BOUNCE_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
 /* Returns the number of sectors to allocate for an inode SIZE
  * bytes long. */
 static inline size_t
@@ -93,11 +104,14 @@ bool inode_create(disk_sector_t sector, off_t length)
 			disk_write(filesys_disk, sector, disk_inode);
 			if (sectors > 0)
 			{
-				static char zeros[DISK_SECTOR_SIZE];
+				static char zeros[ZERO_CHUNK_SECTORS * DISK_SECTOR_SIZE];
 				size_t i;
 
-				for (i = 0; i < sectors; i++)
-					disk_write(filesys_disk, disk_inode->start + i, zeros);
+				for (i = 0; i < sectors; i += ZERO_CHUNK_SECTORS)
+				{
+					size_t cnt = sectors - i < ZERO_CHUNK_SECTORS ? sectors - i : ZERO_CHUNK_SECTORS;
+					disk_write_multiple(filesys_disk, disk_inode->start + i, zeros, cnt);
+				}
 			}
 			success = true;
 		}
@@ -214,6 +228,7 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
 	uint8_t *bounce = NULL;
+	uint8_t *user_bounce = NULL;
 
 	while (size > 0)
 	{
@@ -233,8 +248,24 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE)
 		{
-			/* Read full sector directly into caller's buffer. */
-			disk_read(filesys_disk, sector_idx, buffer + bytes_read);
+			/* Read every remaining full sector directly into caller's
+			 * buffer with one command, or a page of them through a
+			 * kernel page if the buffer is user memory.  File data is
+			 * contiguous. */
+			off_t run = size < inode_left ? size : inode_left;
+			size_t sector_cnt = run / DISK_SECTOR_SIZE;
+			if (is_kernel_vaddr(buffer + bytes_read))
+				disk_read_multiple(filesys_disk, sector_idx, buffer + bytes_read, sector_cnt);
+			else
+			{
+				if (user_bounce == NULL && (user_bounce = palloc_get_page(0)) == NULL)
+					break;
+				if (sector_cnt > USER_BOUNCE_SECTORS)
+					sector_cnt = USER_BOUNCE_SECTORS;
+				disk_read_multiple(filesys_disk, sector_idx, user_bounce, sector_cnt);
+				memcpy(buffer + bytes_read, user_bounce, sector_cnt * DISK_SECTOR_SIZE);
+			}
+			chunk_size = sector_cnt * DISK_SECTOR_SIZE;
 		}
 		else
 		{
@@ -256,6 +287,8 @@ off_t inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset
 		bytes_read += chunk_size;
 	}
 	free(bounce);
+	if (user_bounce != NULL)
+		palloc_free_page(user_bounce);
 
 	return bytes_read;
 }
@@ -271,6 +304,7 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
 	uint8_t *bounce = NULL;
+	uint8_t *user_bounce = NULL;
 
 	if (inode->deny_write_cnt)
 		return 0;
@@ -293,8 +327,23 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE)
 		{
-			/* Write full sector directly to disk. */
-			disk_write(filesys_disk, sector_idx, buffer + bytes_written);
+			/* Write every remaining full sector directly to disk with
+			 * one command, or a page of them through a kernel page if
+			 * the buffer is user memory.  File data is contiguous. */
+			off_t run = size < inode_left ? size : inode_left;
+			size_t sector_cnt = run / DISK_SECTOR_SIZE;
+			if (is_kernel_vaddr(buffer + bytes_written))
+				disk_write_multiple(filesys_disk, sector_idx, buffer + bytes_written, sector_cnt);
+			else
+			{
+				if (user_bounce == NULL && (user_bounce = palloc_get_page(0)) == NULL)
+					break;
+				if (sector_cnt > USER_BOUNCE_SECTORS)
+					sector_cnt = USER_BOUNCE_SECTORS;
+				memcpy(user_bounce, buffer + bytes_written, sector_cnt * DISK_SECTOR_SIZE);
+				disk_write_multiple(filesys_disk, sector_idx, user_bounce, sector_cnt);
+			}
+			chunk_size = sector_cnt * DISK_SECTOR_SIZE;
 		}
 		else
 		{
@@ -323,6 +372,8 @@ off_t inode_write_at(struct inode *inode, const void *buffer_, off_t size,
 		bytes_written += chunk_size;
 	}
 	free(bounce);
+	if (user_bounce != NULL)
+		palloc_free_page(user_bounce);
 
 	return bytes_written;
 }
@@ -345,6 +396,13 @@ void inode_allow_write(struct inode *inode)
 	inode->deny_write_cnt--;
 }
 
+/* Returns true if writes to INODE are denied, as they are while a
+ * process runs the program it holds. */
+bool inode_is_write_denied(const struct inode *inode)
+{
+	return inode->deny_write_cnt > 0;
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t inode_length(const struct inode *inode)
 {
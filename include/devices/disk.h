@@ -2,6 +2,9 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Size of a disk sector in bytes. */
@@ -15,13 +18,51 @@ typedef uint32_t disk_sector_t;
  * printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+/* Order in which each channel serves queued requests.
+ * Selected on the kernel command line with "-iosched=clook|deadline". */
+enum disk_sched_policy
+{
+	DISK_SCHED_CLOOK,	 /* Elevator: ascending sectors, then wrap. */
+	DISK_SCHED_DEADLINE, /* C-LOOK, but expired requests go first. */
+};
+extern enum disk_sched_policy disk_sched_policy;
+
+struct disk_request;
+typedef void disk_done_func(struct disk_request *);
+
+/* An asynchronous disk request.  See disk_submit(). */
+struct disk_request
+{
+	struct disk *disk;
+	disk_sector_t sec_no; /* First sector. */
+	void *buffer;		  /* CNT * DISK_SECTOR_SIZE bytes. */
+	size_t cnt;			  /* Number of sectors. */
+	bool write;			  /* True to write, false to read. */
+	disk_done_func *done; /* Called when the transfer is over. */
+	void *aux;			  /* For use by DONE. */
+
+	/* Owned by disk.c. */
+	struct list_elem elem;		/* Sorted queue or batch element. */
+	struct list_elem fifo_elem; /* Arrival order queue element. */
+	int64_t deadline;			/* Tick after which it is overdue. */
+};
+
 void disk_init(void);
 void disk_print_stats(void);
 
 struct disk *disk_get(int chan_no, int dev_no);
 disk_sector_t disk_size(struct disk *);
+const char *disk_name(struct disk *);
 void disk_read(struct disk *, disk_sector_t, void *);
 void disk_write(struct disk *, disk_sector_t, const void *);
+void disk_read_multiple(struct disk *, disk_sector_t, void *, size_t cnt);
+void disk_write_multiple(struct disk *, disk_sector_t, const void *,
+						 size_t cnt);
+void disk_request_init(struct disk_request *, struct disk *, disk_sector_t,
+					   void *buffer, size_t cnt, bool write,
+					   disk_done_func *done, void *aux);
+void disk_submit(struct disk_request *);
+void disk_submit_many(struct disk_request **, size_t cnt);
 
 void register_disk_inspect_intr();
 #endif /* devices/disk.h */
@@ -37,6 +37,14 @@ enum
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra for Project 3 */
+	SYS_SPAWN,	 /* Start a new process running a program. */
+	SYS_MADVISE, /* Advise on the use of a range of memory. */
+	SYS_MSYNC,	 /* Write a file mapping back to its file. */
+	SYS_MLOCK,	 /* Lock pages in memory. */
+	SYS_MUNLOCK, /* Unlock pages locked by mlock. */
+	SYS_BRK,	 /* Move the end of the heap. */
 };
 
 #endif /* lib/syscall-nr.h */
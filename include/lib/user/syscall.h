@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -13,6 +14,26 @@ typedef int pid_t;
 typedef int off_t;
 #define MAP_FAILED ((void *)NULL)
 
+/* May be or'd into mmap()'s WRITABLE: read the whole mapping in
+ * before returning. */
+#define MAP_POPULATE 0x100
+
+/* May be or'd into mmap()'s WRITABLE: map zero-filled memory instead
+ * of a file.  FD is ignored, and a null ADDR lets the kernel choose
+ * where the mapping goes. */
+#define MAP_ANONYMOUS 0x200
+
+/* Advice for madvise(). */
+#define MADV_NORMAL 0	  /* No special treatment. */
+#define MADV_RANDOM 1	  /* Expect page references in random order. */
+#define MADV_SEQUENTIAL 2 /* Expect page references in sequential order. */
+#define MADV_WILLNEED 3	  /* Will need these pages soon. */
+#define MADV_DONTNEED 4	  /* Do not need these pages any more. */
+
+/* Flags for msync(). */
+#define MS_ASYNC 1 /* Leave the writes to the kernel's writeback. */
+#define MS_SYNC 4  /* Write back before returning. */
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -39,8 +60,15 @@ void close(int fd);
 int dup2(int oldfd, int newfd);
 
 /* Project 3 and optionally project 4. */
+pid_t spawn(const char *cmd_line);
 void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap(void *addr);
+int madvise(void *addr, size_t length, int advice);
+int msync(void *addr, size_t length, int flags);
+int mlock(const void *addr, size_t length);
+int munlock(const void *addr, size_t length);
+int brk(void *addr);
+void *sbrk(intptr_t increment);
 
 /* Project 4 only. */
 bool chdir(const char *dir);
@@ -125,6 +125,7 @@ struct thread
 	struct file **fd_table;
 	int fd_table_size;
 	struct semaphore fork_sema;
+	bool load_ok; /* spawn()으로 만든 자식이 프로그램을 올렸는지 (fork_sema 전에 기록) */
 	struct semaphore wait_sema;
 	struct semaphore exit_sema;
 	bool waited;
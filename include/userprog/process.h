@@ -6,6 +6,7 @@
 
 tid_t process_create_initd(const char *file_name);
 tid_t process_fork(const char *name, struct intr_frame *if_);
+tid_t process_spawn(const char *cmd_line);
 int process_exec(void *f_name);
 int process_wait(tid_t);
 void process_exit(void);
@@ -19,15 +20,49 @@ struct aux
     struct thread *thread;
 };
 
+/* Passed to a process started by process_spawn(). */
+struct spawn_aux
+{
+    char *cmd_line; /* Page holding the command line. */
+    struct thread *thread; /* Parent. */
+};
+
+struct file_ref;
 struct new_aux
 {
-    struct file *file;
+    struct file *file;     /* REF's file. */
+    struct file_ref *ref;  /* Reference held by this aux. */
     off_t offset;
     size_t page_read_bytes;
+    int refs; /* Not yet loaded pages using this, shared across fork. */
 };
 #ifdef VM
 #define MAP_FAILED ((void *)NULL)
+#define MAP_POPULATE 0x100  /* In mmap()'s WRITABLE, as in lib/user/syscall.h. */
+#define MAP_ANONYMOUS 0x200 /* Likewise. */
 void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap(void *addr);
+
+/* Advice for madvise(), as in lib/user/syscall.h. */
+#define MADV_NORMAL 0
+#define MADV_RANDOM 1
+#define MADV_SEQUENTIAL 2
+#define MADV_WILLNEED 3
+#define MADV_DONTNEED 4
+int madvise(void *addr, size_t length, int advice);
+
+/* Flags for msync(), as in lib/user/syscall.h. */
+#define MS_ASYNC 1
+#define MS_SYNC 4
+int msync(void *addr, size_t length, int flags);
+int mlock(const void *addr, size_t length);
+int munlock(const void *addr, size_t length);
+void *brk(void *addr);
+
+struct page;
+bool lazy_load_segment(struct page *page, struct new_aux *aux);
+void lazy_load_finish(struct page *page, struct new_aux *aux);
+void lazy_aux_get(struct new_aux *aux);
+void lazy_aux_put(struct new_aux *aux);
 #endif
 #endif /* userprog/process.h */
@@ -4,12 +4,30 @@
 struct page;
 enum vm_type;
 
+/* A process's current run of swap slots.  Its anonymous pages are
+   swapped out to consecutive slots NEXT, NEXT+1, ... up to END, so
+   that they end up contiguous on disk. */
+struct swap_cluster
+{
+    size_t next; /* Next global slot to try. */
+    size_t end;  /* End of the cluster, exclusive. */
+};
+
 struct anon_page
 {
-    size_t swap_index; // swap disk에서의 인덱스, -1이면 swap되지 않음
+    size_t swap_index; // 전체 swap slot 번호, -1이면 swap되지 않음
 };
 
+/* -swap: devices to swap to. */
+extern const char *swap_devices_option;
+
 void vm_anon_init(void);
+void swap_print_stats(void);
+bool swap_cache_reclaim(void);
+size_t anon_swap_out_batch(struct page **pages, size_t cnt);
 bool anon_initializer(struct page *page, enum vm_type type, void *kva);
+bool anon_share_slot(struct page *page, struct page *src);
+bool anon_share_map(struct page *page);
+bool anon_prefetch(struct page *page);
 
 #endif
@@ -6,16 +6,39 @@
 struct page;
 enum vm_type;
 
-struct file_page
+/* An open file shared by a region and all of its pages, which take
+ * references to it instead of each reopening the file. */
+struct file_ref
 {
 	struct file *file;
+	int refs; /* Protected by filesys_lock. */
+};
+
+struct file_page
+{
+	struct file *file;			  /* REF's file. */
+	struct file_ref *ref;		  /* Reference held by this page. */
 	off_t offset;
 	size_t page_read_bytes;
+	struct file_share *share;	  /* Shared frame, if read-only and shared. */
+	struct list_elem share_elem; /* file_share's list of pages. */
 };
 
+/* Most pages one fault reads in, including the faulting page.
+ * Set on the kernel command line with "-fault-around=N". */
+extern size_t fault_around_pages;
+
 void vm_file_init(void);
 bool file_backed_initializer(struct page *page, enum vm_type type, void *kva);
+struct file_ref *file_ref_open(struct file *file);
+struct file_ref *file_ref_get(struct file_ref *ref);
+void file_ref_put(struct file_ref *ref);
 void *do_mmap(void *addr, size_t length, int writable,
 			  struct file *file, off_t offset);
 void do_munmap(void *va);
+bool file_read_around(struct page *page, struct file *file, off_t ofs,
+					  size_t read_bytes, void *kva);
+void file_print_stats(void);
+bool file_share_map(struct page *page);
+void file_share_add(struct page *page);
 #endif
@@ -29,6 +29,7 @@ enum vm_type
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/vma.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -38,6 +39,38 @@ struct thread;
 
 #define VM_TYPE(type) ((type) & 7)
 
+/* Page replacement policy used by vm_get_victim().
+ * Selected on the kernel command line with "-evict=lru|clock". */
+enum vm_evict_policy
+{
+	VM_EVICT_LRU,	/* Scan the frame table for the lowest age. */
+	VM_EVICT_CLOCK, /* Second chance on the hardware accessed bit. */
+};
+extern enum vm_evict_policy vm_evict_policy;
+
+/* Free user frame watermarks of the reclaim daemon, in pages.
+ * Set on the kernel command line with "-wmark-low=N" and
+ * "-wmark-high=N". */
+extern size_t vm_wmark_low;
+extern size_t vm_wmark_high;
+
+/* Pages the same-page merging daemon scans per pass, 0 if it is off.
+ * Set on the kernel command line with "-ksm[=N]". */
+extern size_t vm_ksm_pages;
+
+/* Milliseconds between runs of the dirty page writeback thread, 0 if
+ * it is off.  Set on the kernel command line with "-flush-interval=MS". */
+extern unsigned vm_flush_interval;
+
+/* Most pages one process may lock with mlock().  Set on the kernel
+ * command line with "-mlock-limit=PAGES"; zero means a default based
+ * on the size of the user pool. */
+extern size_t vm_mlock_limit;
+
+/* Map untouched 2 MB stretches of anonymous regions with large
+ * pages?  Set on the kernel command line with "-large-pages". */
+extern bool vm_large_pages;
+
 /* The representation of "page".
  * This is kind of "parent class", which has four "child class"es, which are
  * uninit_page, file_page, anon_page, and page cache (project4).
@@ -51,9 +84,9 @@ struct page
 	/* Your implementation */
 	struct hash_elem hash_elem;
 	bool writable;
-	int mapped_page_count;
-	int last_used_tick;
+	bool locked;	/* Pinned in memory by mlock(). */
 	uint64_t *pml4; /* Owner's page table */
+	struct supplemental_page_table *spt; /* Owner's SPT */
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
 	union
@@ -74,6 +107,18 @@ struct frame
 	struct page *page;
 	struct list_elem frame_elem;
 	int ref_count;
+	uint8_t age; /* Aging counter, MSB = referenced in the last period. */
+	bool zeroed; /* Handed out holding only zeros; the page need not clear it. */
+	int lock_cnt;  /* mlock()ed pages that map it; never evicted if nonzero. */
+	bool evicting; /* Taken off the frame table to be evicted. */
+
+	/* Same-page merging.  Protected by frame_lock. */
+	uint64_t ksm_sum;			/* Checksum when last scanned. */
+	struct hash_elem ksm_elem;	/* Candidate table element. */
+	bool ksm_listed;			/* In the candidate table? */
+	bool merged;				/* Shared by merging identical pages. */
+
+	struct file_share *share; /* Shared read-only file page, or NULL. */
 };
 
 /* The function table for page operations.
@@ -100,6 +145,12 @@ struct page_operations
 struct supplemental_page_table
 {
 	struct hash spt_hash;
+	struct list vmas;				  /* Regions, by address. */
+	struct swap_cluster swap_cluster; /* Where to swap out pages next. */
+	int pin_cnt;					  /* Kernel writes into user pages in progress. */
+	size_t locked_cnt;				  /* Pages locked by mlock(). */
+	void *heap_start;				  /* First page of the heap. */
+	void *brk;						  /* Current program break. */
 };
 
 #include "threads/thread.h"
@@ -109,10 +160,12 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst,
 void supplemental_page_table_kill(struct supplemental_page_table *spt);
 struct page *spt_find_page(struct supplemental_page_table *spt,
 						   void *va);
+struct page *spt_peek_page(struct supplemental_page_table *spt, void *va);
 bool spt_insert_page(struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page(struct supplemental_page_table *spt, struct page *page);
 
 void vm_init(void);
+void vm_print_stats(void);
 bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user,
 						 bool write, bool not_present);
 
@@ -121,11 +174,25 @@ bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user,
 bool vm_alloc_page_with_initializer(enum vm_type type, void *upage,
 									bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page(struct page *page);
+void vm_free_frame(struct frame *frame);
+struct frame *vm_try_get_frame(void);
+void vm_share_frame(struct page *page, struct frame *frame);
+void vm_ref_frame(struct frame *frame);
+void vm_unref_frame(struct frame *frame);
+bool vm_put_frame(struct page *page);
+bool vm_wait_evict(struct page *page);
+void vm_destroy_begin(struct page *page);
 bool vm_claim_page(void *va);
+bool vm_unshare_page(struct page *page);
+void vm_prefetch(void *start, void *end);
+void vm_discard(void *start, void *end);
+void vm_sync(void *start, void *end);
+void vm_populate(void *start, void *end);
+bool vm_mlock(void *start, void *end);
+void vm_munlock(void *start, void *end);
 enum vm_type page_get_type(struct page *page);
 
 uint64_t hash_hash(const struct hash_elem *e, void *aux UNUSED);
 bool hash_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED);
-bool lru_less(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 void hash_destructor(struct hash_elem *e, void *aux);
 #endif /* VM_VM_H */
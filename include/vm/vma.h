@@ -0,0 +1,60 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/vm.h"
+
+/* Bytes below USER_STACK the stack may grow into.  The heap and
+ * mappings placed by the kernel stay below them. */
+#define STACK_MAX_SIZE (1 << 20)
+
+struct page;
+struct file;
+struct file_ref;
+struct supplemental_page_table;
+
+/* Access pattern a region was advised with by madvise(). */
+enum vma_advice
+{
+	VMA_ADV_NORMAL,		/* Default readahead and eviction. */
+	VMA_ADV_RANDOM,		/* No readahead. */
+	VMA_ADV_SEQUENTIAL, /* Most readahead; pages behind the faults go first. */
+};
+
+/* A region of a process's address space, such as an executable
+ * segment or a file mapping.  Its pages get a struct page only when
+ * they are first looked up, by spt_find_page(). */
+struct vma
+{
+	struct list_elem elem; /* supplemental_page_table's vmas, by start. */
+	void *start;		   /* First page. */
+	void *end;			   /* End, exclusive, page aligned. */
+	enum vm_type type;	   /* Type of the pages: VM_ANON or VM_FILE. */
+	bool writable;
+	bool mmapped;		   /* Made by mmap(), removed by munmap(). */
+	bool split;			   /* Rest of the region before it, split off by madvise(). */
+	enum vma_advice advice;
+	struct file_ref *ref;  /* File, shared with the pages, or NULL. */
+	off_t offset;		   /* File offset of START. */
+	size_t read_bytes;	   /* Bytes of file data from START; zeros follow. */
+};
+
+struct vma *vma_map(struct supplemental_page_table *spt, void *start, size_t length,
+					enum vm_type type, bool writable, struct file *file,
+					off_t offset, size_t read_bytes);
+void vma_unmap(struct supplemental_page_table *spt, struct vma *vma);
+struct vma *vma_find(struct supplemental_page_table *spt, void *va);
+bool vma_range_free(struct supplemental_page_table *spt, void *start, void *end);
+void *vma_find_free(struct supplemental_page_table *spt, size_t length);
+void vma_heap_init(struct supplemental_page_table *spt);
+void *vma_brk(struct supplemental_page_table *spt, void *addr);
+struct page *vma_page_in(struct supplemental_page_table *spt, void *va);
+bool vma_advise(struct supplemental_page_table *spt, void *start, void *end,
+				enum vma_advice advice);
+enum vma_advice vma_advice_at(struct supplemental_page_table *spt, void *va);
+bool vma_copy(struct supplemental_page_table *dst, struct supplemental_page_table *src);
+void vma_kill(struct supplemental_page_table *spt);
+
+#endif /* vm/vma.h */
@@ -0,0 +1,17 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+
+/* -zswap: most kernel pages the compressed swap cache may use.
+ * 0 turns it off. */
+extern size_t zswap_max_pages;
+
+void zswap_init(void);
+bool zswap_store(size_t slot, const void *kva);
+bool zswap_load(size_t slot, void *kva);
+bool zswap_contains(size_t slot);
+void zswap_invalidate(size_t slot);
+void zswap_print_stats(void);
+
+#endif /* vm/zswap.h */
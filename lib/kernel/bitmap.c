@@ -242,15 +242,24 @@ bitmap_count(const struct bitmap *b, size_t start, size_t cnt, bool value)
    exclusive, are set to VALUE, and false otherwise. */
 bool bitmap_contains(const struct bitmap *b, size_t start, size_t cnt, bool value)
 {
-	size_t i;
+	size_t end = start + cnt;
 
 	ASSERT(b != NULL);
 	ASSERT(start <= b->bit_cnt);
 	ASSERT(start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test(b, start + i) == value)
+	/* Test up to a whole element at a time. */
+	while (start < end)
+	{
+		size_t ofs = start % ELEM_BITS;
+		size_t n = ELEM_BITS - ofs < end - start ? ELEM_BITS - ofs : end - start;
+		elem_type mask = (n == ELEM_BITS ? ~(elem_type)0 : ((elem_type)1 << n) - 1) << ofs;
+		elem_type bits = b->bits[elem_idx(start)];
+
+		if ((value ? bits : ~bits) & mask)
 			return true;
+		start += n;
+	}
 	return false;
 }
 
@@ -277,6 +286,28 @@ bool bitmap_all(const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or BITMAP_ERROR if there is none.  Skips whole
+   elements that have no such bit. */
+static size_t
+find_bit(const struct bitmap *b, size_t start, bool value)
+{
+	while (start < b->bit_cnt)
+	{
+		size_t idx = elem_idx(start);
+		elem_type bits = value ? b->bits[idx] : ~b->bits[idx];
+
+		bits &= ~(elem_type)0 << (start % ELEM_BITS);
+		if (bits != 0)
+		{
+			size_t bit_idx = idx * ELEM_BITS + __builtin_ctzl(bits);
+			return bit_idx < b->bit_cnt ? bit_idx : BITMAP_ERROR;
+		}
+		start = (idx + 1) * ELEM_BITS;
+	}
+	return BITMAP_ERROR;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -287,6 +318,8 @@ bitmap_scan(const struct bitmap *b, size_t start, size_t cnt, bool value)
 	ASSERT(b != NULL);
 	ASSERT(start <= b->bit_cnt);
 
+	if (cnt == 1)
+		return find_bit(b, start, value);
 	if (cnt <= b->bit_cnt)
 	{
 		size_t last = b->bit_cnt - cnt;
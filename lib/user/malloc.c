@@ -0,0 +1,234 @@
+#include <malloc.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A simple heap allocator for user programs.
+
+   Small blocks come from the heap, which is grown with sbrk() a
+   chunk at a time.  Free blocks are kept on a list sorted by
+   address, are found first-fit, and are merged with free
+   neighbors when freed; a large enough free block at the top of
+   the heap is given back with sbrk().
+
+   Large blocks each get an anonymous mapping of their own, which
+   free() unmaps, so they never fragment the heap. */
+
+/* Header in front of every block. */
+struct header
+{
+	size_t size;   /* Bytes in the block, header included. */
+	size_t mapped; /* Nonzero if the block is a mapping of its own. */
+};
+
+/* A free block on the heap. */
+struct free_block
+{
+	struct header hdr;
+	struct free_block *next; /* Next free block, by address. */
+};
+
+#define PAGE_SIZE 4096
+#define ALIGNMENT 16						/* Alignment of returned blocks. */
+#define MIN_BLOCK sizeof(struct free_block) /* Smallest block. */
+#define HEAP_CHUNK (64 * 1024)				/* Least the heap grows by. */
+#define MMAP_THRESHOLD (128 * 1024)			/* Blocks this big are mapped. */
+#define TRIM_THRESHOLD (256 * 1024)			/* Free top this big is given back. */
+
+static struct free_block *free_list;
+
+static void *map_block(size_t size);
+static struct free_block *grow_heap(size_t size);
+static void insert_free(struct free_block *b);
+static void trim_heap(struct free_block *b);
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc(size_t size)
+{
+	struct free_block **bp, *b;
+
+	if (size == 0 || size > SIZE_MAX / 2)
+		return NULL;
+	size = ROUND_UP(size + sizeof(struct header), ALIGNMENT);
+	if (size < MIN_BLOCK)
+		size = MIN_BLOCK;
+	if (size >= MMAP_THRESHOLD)
+		return map_block(size);
+
+	for (;;)
+	{
+		for (bp = &free_list; *bp != NULL; bp = &(*bp)->next)
+		{
+			b = *bp;
+			if (b->hdr.size < size)
+				continue;
+			if (b->hdr.size - size >= MIN_BLOCK)
+			{
+				/* Split, leaving the rest on the list. */
+				struct free_block *rest = (struct free_block *)((uint8_t *)b + size);
+				rest->hdr.size = b->hdr.size - size;
+				rest->hdr.mapped = 0;
+				rest->next = b->next;
+				*bp = rest;
+				b->hdr.size = size;
+			}
+			else
+				*bp = b->next;
+			return &b->hdr + 1;
+		}
+		if (grow_heap(size) == NULL)
+			return NULL;
+	}
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc(size_t a, size_t b)
+{
+	void *p;
+
+	if (b != 0 && a > SIZE_MAX / b)
+		return NULL;
+	p = malloc(a * b);
+	if (p != NULL)
+		memset(p, 0, a * b);
+	return p;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly moving
+   it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc(void *old_block, size_t new_size)
+{
+	struct header *h;
+	size_t old_size;
+	void *new_block;
+
+	if (old_block == NULL)
+		return malloc(new_size);
+	if (new_size == 0)
+	{
+		free(old_block);
+		return NULL;
+	}
+
+	h = (struct header *)old_block - 1;
+	old_size = h->size - sizeof *h;
+	if (new_size <= old_size)
+		return old_block;
+	new_block = malloc(new_size);
+	if (new_block != NULL)
+	{
+		memcpy(new_block, old_block, old_size);
+		free(old_block);
+	}
+	return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void free(void *p)
+{
+	struct header *h;
+
+	if (p == NULL)
+		return;
+	h = (struct header *)p - 1;
+	if (h->mapped)
+		munmap(h);
+	else
+		insert_free((struct free_block *)h);
+}
+
+/* Returns a block of SIZE bytes in an anonymous mapping of its own,
+   or a null pointer if the mapping fails. */
+static void *
+map_block(size_t size)
+{
+	struct header *h;
+
+	size = ROUND_UP(size, PAGE_SIZE);
+	h = mmap(NULL, size, 1 | MAP_ANONYMOUS, -1, 0);
+	if (h == MAP_FAILED)
+		return NULL;
+	h->size = size;
+	h->mapped = 1;
+	return h + 1;
+}
+
+/* Grows the heap by at least SIZE bytes and puts the new space on
+   the free list.  Returns the free block holding it, or a null
+   pointer if the heap cannot grow. */
+static struct free_block *
+grow_heap(size_t size)
+{
+	struct free_block *b;
+	size_t grow = ROUND_UP(size > HEAP_CHUNK ? size : HEAP_CHUNK, PAGE_SIZE);
+	uint8_t *top = sbrk(0);
+
+	/* Keep blocks aligned even if someone else moved the break. */
+	size_t pad = ROUND_UP((uintptr_t)top, ALIGNMENT) - (uintptr_t)top;
+	if (sbrk(grow + pad) == (void *)-1)
+		return NULL;
+	b = (struct free_block *)(top + pad);
+	b->hdr.size = grow;
+	b->hdr.mapped = 0;
+	insert_free(b);
+	return b;
+}
+
+/* Puts B on the free list in address order, merging it with the
+   free blocks right before and after it. */
+static void
+insert_free(struct free_block *b)
+{
+	struct free_block *prev = NULL, *next = free_list;
+
+	while (next != NULL && next < b)
+	{
+		prev = next;
+		next = next->next;
+	}
+
+	if (next != NULL && (uint8_t *)b + b->hdr.size == (uint8_t *)next)
+	{
+		b->hdr.size += next->hdr.size;
+		next = next->next;
+	}
+	b->next = next;
+	if (prev != NULL && (uint8_t *)prev + prev->hdr.size == (uint8_t *)b)
+	{
+		prev->hdr.size += b->hdr.size;
+		prev->next = next;
+		b = prev;
+	}
+	else if (prev != NULL)
+		prev->next = b;
+	else
+		free_list = b;
+
+	if (b->next == NULL)
+		trim_heap(b);
+}
+
+/* Gives back to the kernel the whole pages at the end of B, the
+   last free block, if B reaches the break and is large. */
+static void
+trim_heap(struct free_block *b)
+{
+	size_t release;
+
+	if (b->hdr.size < TRIM_THRESHOLD || (uint8_t *)b + b->hdr.size != sbrk(0))
+		return;
+	release = ROUND_DOWN(b->hdr.size - HEAP_CHUNK, PAGE_SIZE);
+	if (sbrk(-(intptr_t)release) != (void *)-1)
+		b->hdr.size -= release;
+}
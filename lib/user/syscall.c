@@ -90,6 +90,11 @@ int exec(const char *file)
 	return (pid_t)syscall1(SYS_EXEC, file);
 }
 
+pid_t spawn(const char *cmd_line)
+{
+	return (pid_t)syscall1(SYS_SPAWN, cmd_line);
+}
+
 int wait(pid_t pid)
 {
 	return syscall1(SYS_WAIT, pid);
@@ -157,6 +162,43 @@ void munmap(void *addr)
 	syscall1(SYS_MUNMAP, addr);
 }
 
+int madvise(void *addr, size_t length, int advice)
+{
+	return syscall3(SYS_MADVISE, addr, length, advice);
+}
+
+int msync(void *addr, size_t length, int flags)
+{
+	return syscall3(SYS_MSYNC, addr, length, flags);
+}
+
+int mlock(const void *addr, size_t length)
+{
+	return syscall2(SYS_MLOCK, addr, length);
+}
+
+int munlock(const void *addr, size_t length)
+{
+	return syscall2(SYS_MUNLOCK, addr, length);
+}
+
+/* The kernel's brk returns the new break, or the current one if it
+ * cannot move the break; brk(NULL) thus asks for the current one. */
+int brk(void *addr)
+{
+	return (void *)syscall1(SYS_BRK, addr) == addr ? 0 : -1;
+}
+
+void *
+sbrk(intptr_t increment)
+{
+	char *old = (char *)syscall1(SYS_BRK, NULL);
+
+	if (increment != 0 && brk(old + increment) != 0)
+		return (void *)-1;
+	return old;
+}
+
 bool chdir(const char *dir)
 {
 	return syscall1(SYS_CHDIR, dir);
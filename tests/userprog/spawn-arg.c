@@ -0,0 +1,18 @@
+/* Spawns child processes with and without arguments and waits for
+   each of them to collect its exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void)
+{
+  pid_t pid;
+
+  CHECK((pid = spawn("child-args childarg")) > 0,
+        "spawn(\"child-args childarg\")");
+  msg("wait(spawn()) = %d", wait(pid));
+
+  CHECK((pid = spawn("child-simple")) > 0, "spawn(\"child-simple\")");
+  msg("wait(spawn()) = %d", wait(pid));
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-arg) begin
+(spawn-arg) spawn("child-args childarg")
+(args) begin
+(args) argc = 2
+(args) argv[0] = 'child-args'
+(args) argv[1] = 'childarg'
+(args) argv[2] = null
+(args) end
+child-args: exit(0)
+(spawn-arg) wait(spawn()) = 0
+(spawn-arg) spawn("child-simple")
+(child-simple) run
+child-simple: exit(81)
+(spawn-arg) wait(spawn()) = 81
+(spawn-arg) end
+spawn-arg: exit(0)
+EOF
+pass;
@@ -0,0 +1,16 @@
+/* Spawns a process that loads, then is killed for bad behavior
+   before its parent runs again.  spawn() must still return its pid,
+   and wait() must return its exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void)
+{
+  pid_t child = spawn("child-bad");
+
+  if (child == -1)
+    fail("spawn(\"child-bad\") returned -1");
+  msg("wait(spawn()) = %d", wait(child));
+}
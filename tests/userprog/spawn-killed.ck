@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF', <<'EOF']);
+(spawn-killed) begin
+(child-bad) begin
+load: pintos: open failed
+child-bad: exit(-1)
+(spawn-killed) wait(spawn()) = -1
+(spawn-killed) end
+spawn-killed: exit(0)
+EOF
+(spawn-killed) begin
+(child-bad) begin
+child-bad: exit(-1)
+(spawn-killed) wait(spawn()) = -1
+(spawn-killed) end
+spawn-killed: exit(0)
+EOF
+pass;
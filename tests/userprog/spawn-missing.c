@@ -0,0 +1,28 @@
+/* Tries to spawn a nonexistent program, many times over.
+   The spawn system call must return -1 each time, and the kernel
+   must reap the child that failed to load: otherwise the children
+   left behind use up kernel memory long before the loop ends, and
+   the last spawn fails. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SPAWN_CNT 1024
+
+void test_main(void)
+{
+  pid_t pid;
+  int i;
+
+  for (i = 0; i < SPAWN_CNT; i++)
+  {
+    pid = spawn("no-such-file");
+    if (pid != -1)
+      fail("spawn(\"no-such-file\") #%d returned %d", i, pid);
+  }
+  msg("spawn(\"no-such-file\") returned -1 %d times", SPAWN_CNT);
+
+  CHECK((pid = spawn("child-simple")) > 0, "spawn(\"child-simple\")");
+  msg("wait(spawn()) = %d", wait(pid));
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($load) = "load: no-such-file: open failed\n" x 1024;
+check_expected ([<<EOF]);
+(spawn-missing) begin
+${load}(spawn-missing) spawn("no-such-file") returned -1 1024 times
+(spawn-missing) spawn("child-simple")
+(child-simple) run
+child-simple: exit(81)
+(spawn-missing) wait(spawn()) = 81
+(spawn-missing) end
+spawn-missing: exit(0)
+EOF
+pass;
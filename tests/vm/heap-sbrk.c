@@ -0,0 +1,45 @@
+/* Grows the heap with sbrk(), checks that the new memory reads as
+   zeros and keeps what is written to it, then shrinks the heap and
+   grows it again, and checks that the pages given back come back
+   zeroed while the rest are kept.  Lastly moves the break back to
+   the start of the heap, after which the heap must be unmapped. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HEAP_SIZE (2 * 1024 * 1024)
+
+void test_main(void)
+{
+  char *start = sbrk(0);
+  char *p;
+  size_t i;
+
+  CHECK((p = sbrk(HEAP_SIZE)) == start, "sbrk 2 MB");
+  CHECK(sbrk(0) == start + HEAP_SIZE, "break moved up by 2 MB");
+  for (i = 0; i < HEAP_SIZE; i += PAGE_SIZE)
+    if (p[i] != 0)
+      fail("byte %zu of new heap is not zero", i);
+  for (i = 0; i < HEAP_SIZE; i++)
+    p[i] = i % 251;
+  for (i = 0; i < HEAP_SIZE; i++)
+    if (p[i] != (char)(i % 251))
+      fail("byte %zu of heap is wrong", i);
+  msg("write and read back heap");
+
+  CHECK(sbrk(-HEAP_SIZE / 2) == start + HEAP_SIZE, "shrink heap by 1 MB");
+  CHECK(sbrk(HEAP_SIZE / 2) == start + HEAP_SIZE / 2, "grow heap by 1 MB");
+  for (i = 0; i < HEAP_SIZE / 2; i++)
+    if (p[i] != (char)(i % 251))
+      fail("byte %zu of kept heap is wrong", i);
+  for (i = HEAP_SIZE / 2; i < HEAP_SIZE; i += PAGE_SIZE)
+    if (p[i] != 0)
+      fail("byte %zu of regrown heap is not zero", i);
+  msg("check heap after shrinking and growing");
+
+  CHECK(brk(start - PAGE_SIZE) == -1, "brk below start of heap fails");
+  CHECK(brk(start) == 0, "brk to start of heap");
+  fail("freed heap is readable (%d)", *start);
+}
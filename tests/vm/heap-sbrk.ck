@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(heap-sbrk) begin
+(heap-sbrk) sbrk 2 MB
+(heap-sbrk) break moved up by 2 MB
+(heap-sbrk) write and read back heap
+(heap-sbrk) shrink heap by 1 MB
+(heap-sbrk) grow heap by 1 MB
+(heap-sbrk) check heap after shrinking and growing
+(heap-sbrk) brk below start of heap fails
+(heap-sbrk) brk to start of heap
+heap-sbrk: exit(-1)
+EOF
+pass;
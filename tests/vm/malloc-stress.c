@@ -0,0 +1,105 @@
+/* Allocates, resizes and frees many blocks of random sizes with the
+   user library's malloc(), some of them big enough to get mappings
+   of their own, and checks that no block's contents are overwritten
+   by another's.  Also checks that calloc() returns zeroed memory. */
+
+#include <malloc.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 256
+#define ROUND_CNT 2000
+#define SMALL_MAX 2048
+#define LARGE_MIN (128 * 1024)
+#define LARGE_MAX (384 * 1024)
+
+static unsigned char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Returns a random block size, now and then a large one. */
+static size_t
+pick_size(void)
+{
+  if (random_ulong() % 16 == 0)
+    return LARGE_MIN + random_ulong() % (LARGE_MAX - LARGE_MIN);
+  return 1 + random_ulong() % SMALL_MAX;
+}
+
+/* Fails unless the first SIZE bytes of block I hold its pattern. */
+static void
+check_block(int i, size_t size)
+{
+  size_t j;
+
+  for (j = 0; j < size; j++)
+    if (blocks[i][j] != (unsigned char)i)
+      fail("block %d corrupted at byte %zu of %zu", i, j, sizes[i]);
+}
+
+void test_main(void)
+{
+  unsigned char *z;
+  size_t size, i;
+  int round;
+
+  random_init(0);
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      int b = random_ulong() % BLOCK_CNT;
+
+      if (blocks[b] != NULL)
+        check_block(b, sizes[b]);
+      switch (random_ulong() % 3)
+        {
+        case 0:
+          free(blocks[b]);
+          blocks[b] = NULL;
+          break;
+        case 1:
+          size = pick_size();
+          blocks[b] = realloc(blocks[b], size);
+          if (blocks[b] == NULL)
+            fail("realloc of %zu bytes failed", size);
+          check_block(b, size < sizes[b] ? size : sizes[b]);
+          sizes[b] = size;
+          memset(blocks[b], b, size);
+          break;
+        default:
+          free(blocks[b]);
+          sizes[b] = pick_size();
+          blocks[b] = malloc(sizes[b]);
+          if (blocks[b] == NULL)
+            fail("malloc of %zu bytes failed", sizes[b]);
+          memset(blocks[b], b, sizes[b]);
+          break;
+        }
+      if (blocks[b] == NULL)
+        sizes[b] = 0;
+    }
+  msg("random allocations");
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      if (blocks[i] != NULL)
+        check_block(i, sizes[i]);
+      free(blocks[i]);
+    }
+  msg("check and free all blocks");
+
+  z = calloc(1000, 100);
+  CHECK(z != NULL, "calloc 100000 bytes");
+  for (i = 0; i < 1000 * 100; i++)
+    if (z[i] != 0)
+      fail("byte %zu of calloc'd block is not zero", i);
+  memset(z, 0xcc, 1000 * 100);
+  free(z);
+  z = calloc(100, 10);
+  for (i = 0; i < 100 * 10; i++)
+    if (z[i] != 0)
+      fail("byte %zu of reused calloc'd block is not zero", i);
+  free(z);
+  msg("calloc returns zeroed memory");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(malloc-stress) begin
+(malloc-stress) random allocations
+(malloc-stress) check and free all blocks
+(malloc-stress) calloc 100000 bytes
+(malloc-stress) calloc returns zeroed memory
+(malloc-stress) end
+EOF
+pass;
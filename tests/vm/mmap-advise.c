@@ -0,0 +1,85 @@
+/* Checks madvise().  Pages of the heap and of the bss segment that
+   are advised MADV_DONTNEED must read as zeros afterward, and pages
+   of the data segment must read as the executable initialized them.
+   A file mapping that madvise() split into pieces must be removed
+   whole by munmap(), after which touching it must kill the process.
+   Misaligned addresses and unknown advice must be refused. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ARRAY_SIZE (4 * PAGE_SIZE)
+#define DATA_VALUE 0x5a
+#define MAP_SIZE (4 * PAGE_SIZE)
+#define ACTUAL ((char *)0x10000000)
+
+static char data_arr[ARRAY_SIZE] = {[0 ... ARRAY_SIZE - 1] = DATA_VALUE};
+static char bss_arr[ARRAY_SIZE];
+
+/* Returns the first page boundary at or after P. */
+static char *
+page_round_up(char *p)
+{
+  return (char *)(((uintptr_t)p + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1));
+}
+
+/* Dirties the whole pages of the ARRAY_SIZE bytes at P, drops them
+   with MADV_DONTNEED, and checks that they read as VALUE again. */
+static void
+check_dontneed(const char *name, char *p, char value)
+{
+  char *start = page_round_up(p);
+  size_t size = ARRAY_SIZE - PAGE_SIZE;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    start[i] = i % 251 + 1;
+  CHECK(madvise(start, size, MADV_DONTNEED) == 0, "madvise %s DONTNEED", name);
+  for (i = 0; i < size; i++)
+    if (start[i] != value)
+      fail("byte %zu of %s is %d after DONTNEED, not %d",
+           i, name, start[i], value);
+}
+
+void test_main(void)
+{
+  char buf[PAGE_SIZE];
+  char *heap;
+  int handle;
+  size_t i;
+
+  CHECK(madvise(page_round_up(bss_arr) + 1, PAGE_SIZE, MADV_NORMAL) == -1,
+        "try to madvise at misaligned address");
+  CHECK(madvise(page_round_up(bss_arr), PAGE_SIZE, 99) == -1,
+        "try to madvise with bad advice");
+
+  check_dontneed("bss", bss_arr, 0);
+  check_dontneed("data", data_arr, DATA_VALUE);
+  CHECK((heap = sbrk(ARRAY_SIZE)) != (void *)-1, "sbrk %d bytes", ARRAY_SIZE);
+  check_dontneed("heap", heap, 0);
+
+  CHECK(create("advise.txt", MAP_SIZE), "create \"advise.txt\"");
+  CHECK((handle = open("advise.txt")) > 1, "open \"advise.txt\"");
+  for (i = 0; i < PAGE_SIZE; i++)
+    buf[i] = i % 251;
+  for (i = 0; i < MAP_SIZE / PAGE_SIZE; i++)
+    if (write(handle, buf, PAGE_SIZE) != PAGE_SIZE)
+      fail("write \"advise.txt\" failed");
+  CHECK(mmap(ACTUAL, MAP_SIZE, 0, handle, 0) == ACTUAL, "mmap \"advise.txt\"");
+  CHECK(madvise(ACTUAL + PAGE_SIZE, 2 * PAGE_SIZE, MADV_SEQUENTIAL) == 0,
+        "madvise middle of mapping SEQUENTIAL");
+  for (i = 0; i < MAP_SIZE; i++)
+    if (ACTUAL[i] != (char)(i % PAGE_SIZE % 251))
+      fail("byte %zu of mapping is wrong", i);
+  msg("read mapping");
+  munmap(ACTUAL);
+
+  /* Mapping the range again only works if no piece is left. */
+  CHECK(mmap(ACTUAL, MAP_SIZE, 0, handle, 0) == ACTUAL,
+        "mmap \"advise.txt\" again");
+  munmap(ACTUAL);
+  fail("unmapped memory is readable (%d)", ACTUAL[MAP_SIZE - 1]);
+}
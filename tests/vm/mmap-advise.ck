@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mmap-advise) begin
+(mmap-advise) try to madvise at misaligned address
+(mmap-advise) try to madvise with bad advice
+(mmap-advise) madvise bss DONTNEED
+(mmap-advise) madvise data DONTNEED
+(mmap-advise) sbrk 16384 bytes
+(mmap-advise) madvise heap DONTNEED
+(mmap-advise) create "advise.txt"
+(mmap-advise) open "advise.txt"
+(mmap-advise) mmap "advise.txt"
+(mmap-advise) madvise middle of mapping SEQUENTIAL
+(mmap-advise) read mapping
+(mmap-advise) mmap "advise.txt" again
+mmap-advise: exit(-1)
+EOF
+pass;
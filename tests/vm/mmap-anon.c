@@ -0,0 +1,50 @@
+/* Maps anonymous memory, once where the kernel chooses and once at
+   a fixed address, checks that it reads as zeros and keeps what is
+   written to it, and checks that it is gone after munmap(). */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define MAP_SIZE (1024 * 1024)
+
+static void
+check_map(char *p, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i += PAGE_SIZE)
+    if (p[i] != 0)
+      fail("byte %zu of new mapping is not zero", i);
+  for (i = 0; i < size; i++)
+    p[i] = i % 253;
+  for (i = 0; i < size; i++)
+    if (p[i] != (char)(i % 253))
+      fail("byte %zu of mapping is wrong", i);
+}
+
+void test_main(void)
+{
+  char *fixed = (char *)0x10000000;
+  char *p;
+
+  CHECK((p = mmap(NULL, MAP_SIZE, 1 | MAP_ANONYMOUS, -1, 0)) != MAP_FAILED,
+        "mmap 1 MB anonymous, kernel chooses address");
+  check_map(p, MAP_SIZE);
+  msg("write and read back mapping");
+
+  CHECK(mmap(fixed, MAP_SIZE / 16, 1 | MAP_ANONYMOUS, -1, 0) == fixed,
+        "mmap 64 kB anonymous at fixed address");
+  check_map(fixed, MAP_SIZE / 16);
+  msg("write and read back fixed mapping");
+  CHECK(mmap(fixed + PAGE_SIZE, PAGE_SIZE, 1 | MAP_ANONYMOUS, -1, 0) == MAP_FAILED,
+        "overlapping anonymous mapping fails");
+  CHECK(mmap(NULL, PAGE_SIZE, 1, -1, 0) == MAP_FAILED,
+        "file mapping at null address fails");
+
+  munmap(fixed);
+  munmap(p);
+  msg("munmap both mappings");
+  fail("unmapped memory is readable (%d)", *p);
+}
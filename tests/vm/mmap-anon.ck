@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(mmap-anon) begin
+(mmap-anon) mmap 1 MB anonymous, kernel chooses address
+(mmap-anon) write and read back mapping
+(mmap-anon) mmap 64 kB anonymous at fixed address
+(mmap-anon) write and read back fixed mapping
+(mmap-anon) overlapping anonymous mapping fails
+(mmap-anon) file mapping at null address fails
+(mmap-anon) munmap both mappings
+mmap-anon: exit(-1)
+EOF
+pass;
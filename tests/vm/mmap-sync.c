@@ -0,0 +1,35 @@
+/* Writes to a file through a mapping, writes the mapping back with
+   msync(MS_SYNC), and reads the data in the file back using the read
+   system call before unmapping the file, to verify.  Also checks
+   that msync() refuses MS_ASYNC and MS_SYNC together. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *)0x10000000)
+
+void test_main(void)
+{
+  int handle;
+  void *map;
+  char buf[1024];
+
+  CHECK(create("sample.txt", strlen(sample)), "create \"sample.txt\"");
+  CHECK((handle = open("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK((map = mmap(ACTUAL, 4096, 1, handle, 0)) != MAP_FAILED, "mmap \"sample.txt\"");
+  memcpy(ACTUAL, sample, strlen(sample));
+  CHECK(msync(map, 4096, MS_ASYNC | MS_SYNC) == -1,
+        "try to msync with MS_ASYNC and MS_SYNC");
+  CHECK(msync(map, 4096, MS_SYNC) == 0, "msync \"sample.txt\"");
+
+  /* Read back via read() while the file is still mapped. */
+  CHECK(read(handle, buf, strlen(sample)) == (int)strlen(sample),
+        "read \"sample.txt\"");
+  CHECK(!memcmp(buf, sample, strlen(sample)),
+        "compare read data against written data");
+  munmap(map);
+  close(handle);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-sync) begin
+(mmap-sync) create "sample.txt"
+(mmap-sync) open "sample.txt"
+(mmap-sync) mmap "sample.txt"
+(mmap-sync) try to msync with MS_ASYNC and MS_SYNC
+(mmap-sync) msync "sample.txt"
+(mmap-sync) read "sample.txt"
+(mmap-sync) compare read data against written data
+(mmap-sync) end
+EOF
+pass;
@@ -0,0 +1,104 @@
+/* Checks that fork shares swapped out and never touched pages
+ * copy-on-write.  Forks a process with a large resident and swapped
+ * out footprint, and a region it has never touched, over and over.
+ * For this test, Pintos memory size is 10MB, so most of the written
+ * pages are on the swap disk when the children are forked.
+ * Each child checks every page, writes some of them (copy-on-write),
+ * and checks again.  Lastly the parent checks that none of the
+ * children's writes reached its own pages. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define ONE_MB (1 << 20) // 1MB
+#define CHUNK_SIZE (8 * ONE_MB)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+#define UNTOUCHED_SIZE (1 * ONE_MB)
+#define CHILD_CNT 8
+
+static char big_chunks[CHUNK_SIZE];
+static char untouched[UNTOUCHED_SIZE];
+
+/* Value written at the start and end of page I by writer ID,
+ * 0 being the parent. */
+static int
+page_value(size_t i, int id)
+{
+    return (int)(i * 2654435761u) ^ id;
+}
+
+/* Returns true if every page holds the values the parent wrote, except
+ * that pages written by the child CHILD hold its values. */
+static bool
+check_pages(int child)
+{
+    size_t i;
+
+    for (i = 0; i < PAGE_COUNT; i++)
+    {
+        int *first = (int *)(big_chunks + i * PAGE_SIZE);
+        int *last = (int *)(big_chunks + (i + 1) * PAGE_SIZE) - 1;
+        int id = child != 0 && i % CHILD_CNT == (size_t)child - 1 ? child : 0;
+
+        if (*first != page_value(i, id) || *last != page_value(i, id))
+            return false;
+    }
+    for (i = 0; i < UNTOUCHED_SIZE; i += PAGE_SIZE)
+        if (untouched[i] != 0)
+            return false;
+    return true;
+}
+
+/* Child number ID: checks the pages it inherited, then writes every
+ * CHILD_CNT'th page and checks again. */
+static void
+child_main(int id)
+{
+    size_t i;
+
+    if (!check_pages(0))
+        exit(1);
+    for (i = id - 1; i < PAGE_COUNT; i += CHILD_CNT)
+    {
+        *(int *)(big_chunks + i * PAGE_SIZE) = page_value(i, id);
+        *((int *)(big_chunks + (i + 1) * PAGE_SIZE) - 1) = page_value(i, id);
+    }
+    exit(check_pages(id) ? 0 : 2);
+}
+
+void test_main(void)
+{
+    size_t i;
+    int id;
+
+    msg("write %d MB", CHUNK_SIZE / ONE_MB);
+    for (i = 0; i < PAGE_COUNT; i++)
+    {
+        *(int *)(big_chunks + i * PAGE_SIZE) = page_value(i, 0);
+        *((int *)(big_chunks + (i + 1) * PAGE_SIZE) - 1) = page_value(i, 0);
+    }
+
+    msg("fork %d children", CHILD_CNT);
+    for (id = 1; id <= CHILD_CNT; id++)
+    {
+        pid_t child = fork("child");
+        int status;
+
+        if (child == 0)
+            child_main(id);
+        if (child < 0)
+            fail("fork %d failed", id);
+        status = wait(child);
+        if (status == 1)
+            fail("child %d: inherited data is inconsistent", id);
+        if (status != 0)
+            fail("child %d: data is inconsistent after writing", id);
+    }
+
+    CHECK(check_pages(0), "check consistency in parent");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-fork-cow) begin
+(swap-fork-cow) write 8 MB
+(swap-fork-cow) fork 8 children
+(swap-fork-cow) check consistency in parent
+(swap-fork-cow) end
+EOF
+pass;
@@ -0,0 +1,79 @@
+/* Checks mlock() and mmap(MAP_POPULATE).
+   For this test, Pintos memory size is 10MB and a process may lock
+   at most LOCK_LIMIT pages.  Locking more than that, or a range with
+   an unmapped page in it, must fail and lock nothing.  A locked
+   buffer must keep its contents while the rest of memory is swapped
+   out, and a populated file mapping must read as the file. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define LOCK_LIMIT 64 /* Must match -mlock-limit in Make.tests. */
+#define LOCKED_SIZE (LOCK_LIMIT * PAGE_SIZE)
+#define PRESSURE_SIZE (8 * 1024 * 1024)
+#define FILE_SIZE (8 * PAGE_SIZE)
+#define SHORT_MAP ((char *)0x10000000)
+#define POPULATED ((char *)0x10100000)
+
+static char locked_arr[LOCKED_SIZE + PAGE_SIZE];
+static char pressure[PRESSURE_SIZE];
+
+/* Returns the first page boundary at or after P. */
+static char *
+page_round_up(char *p)
+{
+  return (char *)(((uintptr_t)p + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1));
+}
+
+void test_main(void)
+{
+  char *locked = page_round_up(locked_arr);
+  char buf[PAGE_SIZE];
+  int handle;
+  size_t i;
+
+  CHECK(create("populate.txt", FILE_SIZE), "create \"populate.txt\"");
+  CHECK((handle = open("populate.txt")) > 1, "open \"populate.txt\"");
+  for (i = 0; i < PAGE_SIZE; i++)
+    buf[i] = i % 253;
+  for (i = 0; i < FILE_SIZE / PAGE_SIZE; i++)
+    if (write(handle, buf, PAGE_SIZE) != PAGE_SIZE)
+      fail("write \"populate.txt\" failed");
+  CHECK(mmap(SHORT_MAP, FILE_SIZE, 0, handle, 0) == SHORT_MAP,
+        "mmap \"populate.txt\"");
+
+  CHECK(mlock(pressure, PRESSURE_SIZE) == -1, "try to mlock over the limit");
+  CHECK(mlock(SHORT_MAP, FILE_SIZE + PAGE_SIZE) == -1,
+        "try to mlock a range with an unmapped page");
+
+  /* Only fits in the limit if the calls above locked nothing. */
+  for (i = 0; i < LOCKED_SIZE; i++)
+    locked[i] = i % 251;
+  CHECK(mlock(locked, LOCKED_SIZE) == 0, "mlock %d pages", LOCK_LIMIT);
+
+  for (i = 0; i < PRESSURE_SIZE; i += PAGE_SIZE)
+    pressure[i] = i / PAGE_SIZE;
+  for (i = 0; i < PRESSURE_SIZE; i += PAGE_SIZE)
+    if (pressure[i] != (char)(i / PAGE_SIZE))
+      fail("byte %zu of pressure array is wrong", i);
+  msg("write and read back %d MB", PRESSURE_SIZE / 1024 / 1024);
+
+  for (i = 0; i < LOCKED_SIZE; i++)
+    if (locked[i] != (char)(i % 251))
+      fail("byte %zu of locked memory is wrong", i);
+  msg("check locked memory");
+  CHECK(munlock(locked, LOCKED_SIZE) == 0, "munlock %d pages", LOCK_LIMIT);
+
+  CHECK(mmap(POPULATED, FILE_SIZE, MAP_POPULATE, handle, 0) == POPULATED,
+        "mmap \"populate.txt\" with MAP_POPULATE");
+  for (i = 0; i < FILE_SIZE; i++)
+    if (POPULATED[i] != (char)(i % PAGE_SIZE % 253))
+      fail("byte %zu of populated mapping is wrong", i);
+  msg("check populated mapping");
+  munmap(POPULATED);
+  munmap(SHORT_MAP);
+  close(handle);
+}
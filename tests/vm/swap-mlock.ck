@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-mlock) begin
+(swap-mlock) create "populate.txt"
+(swap-mlock) open "populate.txt"
+(swap-mlock) mmap "populate.txt"
+(swap-mlock) try to mlock over the limit
+(swap-mlock) try to mlock a range with an unmapped page
+(swap-mlock) mlock 64 pages
+(swap-mlock) write and read back 8 MB
+(swap-mlock) check locked memory
+(swap-mlock) munlock 64 pages
+(swap-mlock) mmap "populate.txt" with MAP_POPULATE
+(swap-mlock) check populated mapping
+(swap-mlock) end
+EOF
+pass;
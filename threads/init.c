@@ -31,6 +31,7 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -157,6 +158,17 @@ paging_init(uint64_t mem_end)
 	{
 		uint64_t va = (uint64_t)ptov(pa);
 
+		/* Whole 2 MB chunks without kernel text, which is mapped
+		 * read-only page by page, take a single 2 MB page, so the
+		 * kernel's accesses to memory use few TLB entries. */
+		if (pa % LARGE_PGSIZE == 0 && pa + LARGE_PGSIZE <= mem_end && (va + LARGE_PGSIZE <= (uint64_t)&start || va >= (uint64_t)&_end_kernel_text))
+		{
+			if ((pte = pml4_pde_walk(pml4, va, 1)) != NULL)
+				*pte = pa | PTE_PS | PTE_P | PTE_W;
+			pa += LARGE_PGSIZE - PGSIZE;
+			continue;
+		}
+
 		perm = PTE_P | PTE_W;
 		if ((uint64_t)&start <= va && va < (uint64_t)&_end_kernel_text)
 			perm &= ~PTE_W;
@@ -222,6 +234,15 @@ parse_options(char **argv)
 #ifdef FILESYS
 		else if (!strcmp(name, "-f"))
 			format_filesys = true;
+		else if (!strcmp(name, "-iosched"))
+		{
+			if (value != NULL && !strcmp(value, "clook"))
+				disk_sched_policy = DISK_SCHED_CLOOK;
+			else if (value != NULL && !strcmp(value, "deadline"))
+				disk_sched_policy = DISK_SCHED_DEADLINE;
+			else
+				PANIC("unknown I/O scheduler `%s' (use -h for help)", value);
+		}
 #endif
 		else if (!strcmp(name, "-rs"))
 			random_init(atoi(value));
@@ -232,6 +253,39 @@ parse_options(char **argv)
 			user_page_limit = atoi(value);
 		else if (!strcmp(name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp(name, "-evict"))
+		{
+			if (value != NULL && !strcmp(value, "clock"))
+				vm_evict_policy = VM_EVICT_CLOCK;
+			else if (value != NULL && !strcmp(value, "lru"))
+				vm_evict_policy = VM_EVICT_LRU;
+			else
+				PANIC("unknown eviction policy `%s' (use -h for help)", value);
+		}
+		else if (!strcmp(name, "-wmark-low"))
+			vm_wmark_low = atoi(value);
+		else if (!strcmp(name, "-wmark-high"))
+			vm_wmark_high = atoi(value);
+		else if (!strcmp(name, "-swap"))
+		{
+			if (value == NULL)
+				PANIC("-swap requires a list of disks (use -h for help)");
+			swap_devices_option = value;
+		}
+		else if (!strcmp(name, "-fault-around"))
+			fault_around_pages = atoi(value);
+		else if (!strcmp(name, "-ksm"))
+			vm_ksm_pages = value != NULL ? atoi(value) : 64;
+		else if (!strcmp(name, "-zswap"))
+			zswap_max_pages = value != NULL ? atoi(value) : 64;
+		else if (!strcmp(name, "-large-pages"))
+			vm_large_pages = true;
+		else if (!strcmp(name, "-flush-interval"))
+			vm_flush_interval = atoi(value);
+		else if (!strcmp(name, "-mlock-limit"))
+			vm_mlock_limit = atoi(value);
 #endif
 		else
 			PANIC("unknown option `%s' (use -h for help)", name);
@@ -337,10 +391,32 @@ usage(void)
 		   "  -h                 Print this help message and power off.\n"
 		   "  -q                 Power off VM after actions or on panic.\n"
 		   "  -f                 Format file system disk during startup.\n"
+#ifdef FILESYS
+		   "  -iosched=clook|deadline Select the disk request scheduler.\n"
+#endif
 		   "  -rs=SEED           Set random number seed to SEED.\n"
 		   "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 		   "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+		   "  -evict=lru|clock   Select the page replacement policy.\n"
+		   "  -wmark-low=PAGES   Wake the reclaim daemon below PAGES free frames.\n"
+		   "  -wmark-high=PAGES  Reclaim until PAGES frames are free.\n"
+		   "  -swap=hdC:D[@PRIO],...  Swap to these disks (default hd1:1).\n"
+		   "                     Disks of equal priority are striped.\n"
+		   "  -fault-around=PAGES  Read in up to PAGES file-backed pages per fault\n"
+		   "                     (default 8, 1 disables).\n"
+		   "  -ksm[=PAGES]       Merge identical anonymous pages, scanning PAGES\n"
+		   "                     frames (default 64) every 100 ms.\n"
+		   "  -zswap[=PAGES]     Compress swapped out pages into up to PAGES\n"
+		   "                     kernel pages (default 64) before using disk.\n"
+		   "  -large-pages       Map untouched 2 MB stretches of anonymous\n"
+		   "                     memory with 2 MB pages.\n"
+		   "  -flush-interval=MS  Write back dirty file-mapped pages every MS\n"
+		   "                     milliseconds (default 1000, 0 disables).\n"
+		   "  -mlock-limit=PAGES  Let a process lock at most PAGES pages\n"
+		   "                     (default 1/8 of the user pool).\n"
 #endif
 	);
 	power_off();
@@ -376,4 +452,7 @@ print_stats(void)
 #ifdef USERPROG
 	exception_print_stats();
 #endif
+#ifdef VM
+	vm_print_stats();
+#endif
 }
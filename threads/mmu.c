@@ -8,6 +8,32 @@
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Replaces the 2 MB page that PDE maps, at VA, by a page table of
+ * 4 kB pages that map the same memory with the same flags.  The
+ * addresses do not change, but the page size does, and the TLB may
+ * then hold the old 2 MB entry next to new 4 kB ones; a later change
+ * to one 4 kB page would not reach the stale 2 MB entry.  So every
+ * page of the range is invalidated.  invlpg of an address that the
+ * TLB does not hold is harmless, and a pml4 that is not loaded has
+ * no entries there, so this is done whichever pml4 PDE is in.
+ * Callers count on a large page always being split, so running out
+ * of kernel pages here panics. */
+static void
+pde_split(uint64_t *pde, uint64_t va)
+{
+	uint64_t *pt = palloc_get_page(PAL_ASSERT);
+	uint64_t pa = PTE_ADDR(*pde) & ~(LARGE_PGSIZE - 1);
+	uint64_t flags = *pde & PTE_FLAGS & ~PTE_PS;
+
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop(pt) | PTE_U | PTE_W | PTE_P;
+
+	va &= ~(uint64_t)(LARGE_PGSIZE - 1);
+	for (uint64_t off = 0; off < LARGE_PGSIZE; off += PGSIZE)
+		invlpg(va + off);
+}
+
 static uint64_t *
 pgdir_walk(uint64_t *pdp, const uint64_t va, int create)
 {
@@ -28,6 +54,15 @@ pgdir_walk(uint64_t *pdp, const uint64_t va, int create)
 			else
 				return NULL;
 		}
+		/* A 2 MB page is a leaf of its own.  Looking it up returns
+		 * its PDE; creating an entry for one of its 4 kB pages
+		 * splits it first. */
+		if (pdp[idx] & PTE_PS)
+		{
+			if (!create)
+				return &pdp[idx];
+			pde_split(&pdp[idx], va);
+		}
 		return (uint64_t *)ptov(PTE_ADDR(pdp[idx]) + 8 * PTX(va));
 	}
 	return NULL;
@@ -109,6 +144,39 @@ pml4e_walk(uint64_t *pml4e, const uint64_t va, int create)
 	return pte;
 }
 
+/* Returns the next level table that entry IDX of TABLE points to,
+ * creating it if it does not exist and CREATE is nonzero, or a null
+ * pointer. */
+static uint64_t *
+next_table(uint64_t *table, int idx, int create)
+{
+	if (!(table[idx] & PTE_P))
+	{
+		uint64_t *new_page;
+
+		if (!create || (new_page = palloc_get_page(PAL_ZERO)) == NULL)
+			return NULL;
+		table[idx] = vtop(new_page) | PTE_U | PTE_W | PTE_P;
+	}
+	return ptov(PTE_ADDR(table[idx]));
+}
+
+/* Returns the address of the page directory entry for virtual
+ * address VA in pml4, which maps either a page table or a 2 MB page.
+ * If CREATE is nonzero, missing tables above it are created;
+ * otherwise, or if that fails, a null pointer may be returned. */
+uint64_t *
+pml4_pde_walk(uint64_t *pml4, const uint64_t va, int create)
+{
+	uint64_t *pdpe, *pgdir;
+
+	if ((pdpe = next_table(pml4, PML4(va), create)) == NULL)
+		return NULL;
+	if ((pgdir = next_table(pdpe, PDPE(va), create)) == NULL)
+		return NULL;
+	return &pgdir[PDX(va)];
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -149,10 +217,19 @@ pgdir_for_each(uint64_t *pdp, pte_for_each_func *func, void *aux,
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
 	{
 		uint64_t *pte = ptov((uint64_t *)pdp[i]);
-		if (((uint64_t)pte) & PTE_P)
-			if (!pt_for_each((uint64_t *)PTE_ADDR(pte), func, aux,
-							 pml4_index, pdp_index, i))
+		if (!(((uint64_t)pte) & PTE_P))
+			continue;
+		if (pdp[i] & PTE_PS)
+		{
+			void *va = (void *)(((uint64_t)pml4_index << PML4SHIFT) |
+								((uint64_t)pdp_index << PDPESHIFT) |
+								((uint64_t)i << PDXSHIFT));
+			if (!func(&pdp[i], va, aux))
 				return false;
+		}
+		else if (!pt_for_each((uint64_t *)PTE_ADDR(pte), func, aux,
+							  pml4_index, pdp_index, i))
+			return false;
 	}
 	return true;
 }
@@ -203,7 +280,8 @@ pgdir_destroy(uint64_t *pdp)
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
 	{
 		uint64_t *pte = ptov((uint64_t *)pdp[i]);
-		if (((uint64_t)pte) & PTE_P)
+		// 2 MB 페이지의 frame은 frame table이 해제한다
+		if ((((uint64_t)pte) & PTE_P) && !(pdp[i] & PTE_PS))
 			pt_destroy(PTE_ADDR(pte));
 	}
 	palloc_free_page((void *)pdp);
@@ -253,9 +331,11 @@ pml4_get_page(uint64_t *pml4, const void *uaddr)
 
 	uint64_t *pte = pml4e_walk(pml4, (uint64_t)uaddr, 0);
 
-	if (pte && (*pte & PTE_P))
-		return ptov(PTE_ADDR(*pte)) + pg_ofs(uaddr);
-	return NULL;
+	if (pte == NULL || !(*pte & PTE_P))
+		return NULL;
+	if (*pte & PTE_PS)
+		return ptov(PTE_ADDR(*pte) & ~(LARGE_PGSIZE - 1)) + ((uint64_t)uaddr & (LARGE_PGSIZE - 1));
+	return ptov(PTE_ADDR(*pte)) + pg_ofs(uaddr);
 }
 
 /* Adds a mapping in page map level 4 PML4 from user virtual page
@@ -280,6 +360,43 @@ bool pml4_set_page(uint64_t *pml4, void *upage, void *kpage, bool rw)
 	return pte != NULL;
 }
 
+/* Maps the 2 MB of user virtual memory at UPAGE to the physically
+ * contiguous memory at kernel virtual address KPAGE with one page
+ * directory entry.  Both must be 2 MB aligned.  The range must not
+ * have any page mapped yet; an empty page table left there is freed.
+ * Later changes to single 4 kB pages of the range split it back into
+ * a page table.  Returns false if memory allocation failed or part of
+ * the range is mapped. */
+bool pml4_set_large_page(uint64_t *pml4, void *upage, void *kpage, bool rw)
+{
+	uint64_t *pde, *pt;
+
+	ASSERT(((uint64_t)upage & (LARGE_PGSIZE - 1)) == 0);
+	ASSERT(((uint64_t)kpage & (LARGE_PGSIZE - 1)) == 0);
+	ASSERT(is_user_vaddr(upage));
+	ASSERT(pml4 != base_pml4);
+
+	pde = pml4_pde_walk(pml4, (uint64_t)upage, 1);
+	if (pde == NULL)
+		return false;
+	if (*pde & PTE_P)
+	{
+		if (*pde & PTE_PS)
+			return false;
+		pt = ptov(PTE_ADDR(*pde));
+		for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+			if (pt[i] & PTE_P)
+				return false;
+		*pde = 0;
+		// 이전 page table을 캐시에서 지운 뒤 해제
+		if (rcr3() == vtop(pml4))
+			invlpg((uint64_t)upage);
+		palloc_free_page(pt);
+	}
+	*pde = vtop(kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+	return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
@@ -291,6 +408,8 @@ void pml4_clear_page(uint64_t *pml4, void *upage)
 	ASSERT(is_user_vaddr(upage));
 
 	pte = pml4e_walk(pml4, (uint64_t)upage, false);
+	if (pte != NULL && (*pte & PTE_PS))
+		pte = pml4e_walk(pml4, (uint64_t)upage, true);
 
 	if (pte != NULL && (*pte & PTE_P) != 0)
 	{
@@ -320,7 +439,7 @@ void pml4_set_dirty(uint64_t *pml4, const void *vpage, bool dirty)
 		if (dirty)
 			*pte |= PTE_D;
 		else
-			*pte &= ~(uint32_t)PTE_D;
+			*pte &= ~(uint64_t)PTE_D;
 
 		if (rcr3() == vtop(pml4))
 			invlpg((uint64_t)vpage);
@@ -338,7 +457,8 @@ bool pml4_is_accessed(uint64_t *pml4, const void *vpage)
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
-   VPAGE in PD. */
+   VPAGE in PD.  If VPAGE lies in a 2 MB page, its bit is shared by
+   the whole 2 MB page, which is left whole. */
 void pml4_set_accessed(uint64_t *pml4, const void *vpage, bool accessed)
 {
 	uint64_t *pte = pml4e_walk(pml4, (uint64_t)vpage, false);
@@ -347,7 +467,7 @@ void pml4_set_accessed(uint64_t *pml4, const void *vpage, bool accessed)
 		if (accessed)
 			*pte |= PTE_A;
 		else
-			*pte &= ~(uint32_t)PTE_A;
+			*pte &= ~(uint64_t)PTE_A;
 
 		if (rcr3() == vtop(pml4))
 			invlpg((uint64_t)vpage);
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -32,6 +33,7 @@ struct pool
 	struct lock lock;		 /* Mutual exclusion. */
 	struct bitmap *used_map; /* Bitmap of free pages. */
 	uint8_t *base;			 /* Base of pool. */
+	size_t free_cnt;		 /* Number of free pages. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -43,6 +45,7 @@ static void
 init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool(const struct pool *, void *page);
+static void pool_adjust_free_cnt(struct pool *, ptrdiff_t delta);
 
 /* multiboot info */
 struct multiboot_info
@@ -281,6 +284,10 @@ palloc_init(void)
 	printf("\text_mem: 0x%llx ~ 0x%llx (Usable: %'llu kB)\n",
 		   ext_mem.start, ext_mem.end, ext_mem.size / 1024);
 	populate_pools(&base_mem, &ext_mem);
+	kernel_pool.free_cnt = bitmap_count(kernel_pool.used_map, 0,
+										bitmap_size(kernel_pool.used_map), false);
+	user_pool.free_cnt = bitmap_count(user_pool.used_map, 0,
+									  bitmap_size(user_pool.used_map), false);
 	return ext_mem.end;
 }
 
@@ -297,6 +304,8 @@ palloc_get_multiple(enum palloc_flags flags, size_t page_cnt)
 
 	lock_acquire(&pool->lock);
 	size_t page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
+	if (page_idx != BITMAP_ERROR)
+		pool_adjust_free_cnt(pool, -(ptrdiff_t)page_cnt);
 	lock_release(&pool->lock);
 	void *pages;
 
@@ -319,6 +328,44 @@ palloc_get_multiple(enum palloc_flags flags, size_t page_cnt)
 	return pages;
 }
 
+/* Like palloc_get_multiple(), but the pages also start at an
+   address that is a multiple of PAGE_CNT pages, which must be a
+   power of two, such as the 2 MB needed for a large page. */
+void *
+palloc_get_aligned(enum palloc_flags flags, size_t page_cnt)
+{
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t pool_cnt = bitmap_size(pool->used_map);
+	size_t page_idx = (page_cnt - pg_no(pool->base) % page_cnt) % page_cnt;
+	void *pages = NULL;
+
+	ASSERT(page_cnt > 0 && (page_cnt & (page_cnt - 1)) == 0);
+
+	lock_acquire(&pool->lock);
+	for (; page_idx + page_cnt <= pool_cnt; page_idx += page_cnt)
+		if (bitmap_none(pool->used_map, page_idx, page_cnt))
+		{
+			bitmap_set_multiple(pool->used_map, page_idx, page_cnt, true);
+			pool_adjust_free_cnt(pool, -(ptrdiff_t)page_cnt);
+			pages = pool->base + PGSIZE * page_idx;
+			break;
+		}
+	lock_release(&pool->lock);
+
+	if (pages)
+	{
+		if (flags & PAL_ZERO)
+			memset(pages, 0, PGSIZE * page_cnt);
+	}
+	else
+	{
+		if (flags & PAL_ASSERT)
+			PANIC("palloc_get: out of pages");
+	}
+
+	return pages;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -356,6 +403,21 @@ void palloc_free_multiple(void *pages, size_t page_cnt)
 #endif
 	ASSERT(bitmap_all(pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+	pool_adjust_free_cnt(pool, page_cnt);
+}
+
+/* Returns the number of free pages in the user pool. */
+size_t
+palloc_user_free_cnt(void)
+{
+	return user_pool.free_cnt;
+}
+
+/* Returns the number of pages in the user pool. */
+size_t
+palloc_user_page_cnt(void)
+{
+	return bitmap_size(user_pool.used_map);
 }
 
 /* Frees the page at PAGE. */
@@ -384,6 +446,17 @@ init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end)
 	*bm_base += bm_pages;
 }
 
+/* Adds DELTA to POOL's free page count.  Pages may be freed with
+   interrupts off, where the pool lock cannot be taken, so the
+   count is updated with interrupts disabled instead. */
+static void
+pool_adjust_free_cnt(struct pool *pool, ptrdiff_t delta)
+{
+	enum intr_level old_level = intr_disable();
+	pool->free_cnt += delta;
+	intr_set_level(old_level);
+}
+
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
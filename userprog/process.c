@@ -33,6 +33,9 @@ static void process_cleanup(void);
 static bool load(const char *file_name, struct intr_frame *if_);
 static void initd(void *f_name);
 static void __do_fork(void *aux);
+static void __do_spawn(void *aux);
+static bool duplicate_fd_table(struct thread *parent);
+static bool process_load(char *file_name, struct intr_frame *if_);
 /* General process initializer for initd and other process. */
 static void
 process_init(void)
@@ -104,6 +107,42 @@ tid_t process_fork(const char *name, struct intr_frame *if_)
 	return thread_create(name, PRI_DEFAULT, __do_fork, aux);
 }
 
+/* Starts a new child process running CMD_LINE, the way fork
+ * followed by exec in the child would, but without copying the
+ * current process's address space only to throw it away: the child
+ * inherits just the file descriptor table and loads its program
+ * into an empty address space.  Returns the new process's thread
+ * id, or TID_ERROR if the thread cannot be created. */
+tid_t process_spawn(const char *cmd_line)
+{
+	struct spawn_aux *aux;
+	char name[16], *save_ptr;
+	tid_t tid;
+
+	aux = malloc(sizeof *aux);
+	if (aux == NULL)
+		return TID_ERROR;
+	aux->cmd_line = palloc_get_page(0);
+	if (aux->cmd_line == NULL)
+	{
+		free(aux);
+		return TID_ERROR;
+	}
+	strlcpy(aux->cmd_line, cmd_line, PGSIZE);
+	aux->thread = thread_current();
+
+	// 스레드 이름은 프로그램 이름 (load()가 명령줄을 다시 나눈다)
+	strlcpy(name, cmd_line, sizeof name);
+	strtok_r(name, " ", &save_ptr);
+	tid = thread_create(name, PRI_DEFAULT, __do_spawn, aux);
+	if (tid == TID_ERROR)
+	{
+		palloc_free_page(aux->cmd_line);
+		free(aux);
+	}
+	return tid;
+}
+
 // 자식의 tid로 스레드 찾기
 struct thread *get_thread_by_tid(tid_t child_tid)
 {
@@ -201,6 +240,30 @@ static void __do_fork(void *aux)
 #endif
 
 	/* 3. Duplicate file descriptor table */
+	if (!duplicate_fd_table(parent))
+		goto error;
+
+	/* Finally, switch to the newly created process. */
+	if (succ)
+	{
+		sema_up(&current->fork_sema);
+		if_.R.rax = 0; // 자식 프로세스는 0을 반환
+		do_iret(&if_);
+	}
+error:
+	current->exit_status = -1;
+	sema_up(&current->fork_sema);
+	thread_exit();
+}
+
+/* Copies PARENT's file descriptor table into the current process's,
+ * which must have room for as many descriptors.  Returns false if
+ * out of memory. */
+static bool
+duplicate_fd_table(struct thread *parent)
+{
+	struct thread *current = thread_current();
+
 	for (int fd = 0; fd < parent->fd_table_size; fd++)
 	{
 		struct file *f = parent->fd_table[fd];
@@ -236,17 +299,53 @@ static void __do_fork(void *aux)
 				// 아니면 file_duplicate써서 새로 파일 만들기
 				current->fd_table[fd] = file_duplicate(f);
 				if (current->fd_table[fd] == NULL)
-					goto error;
+					return false;
 			}
 		}
 	}
-	/* Finally, switch to the newly created process. */
-	if (succ)
+	return true;
+}
+
+/* A thread function that starts the process created by
+ * process_spawn().  Reports to the parent, which waits on
+ * fork_sema as for fork, whether the program could be loaded, in
+ * load_ok: once fork_sema is up the child may already have exited,
+ * so its exit status does not tell. */
+static void
+__do_spawn(void *aux_)
+{
+	struct spawn_aux *aux = aux_;
+	struct thread *current = thread_current();
+	struct thread *parent = aux->thread;
+	char *cmd_line = aux->cmd_line;
+	struct intr_frame if_;
+
+	free(aux);
+#ifdef VM
+	supplemental_page_table_init(&current->spt);
+#endif
+	current->fd_table_size = parent->fd_table_size;
+	current->fd_table = malloc(sizeof(struct file *) * parent->fd_table_size);
+	if (current->fd_table == NULL)
 	{
-		sema_up(&current->fork_sema);
-		if_.R.rax = 0; // 자식 프로세스는 0을 반환
-		do_iret(&if_);
+		palloc_free_page(cmd_line);
+		goto error;
+	}
+	process_init();
+	if (!duplicate_fd_table(parent))
+	{
+		palloc_free_page(cmd_line);
+		goto error;
 	}
+
+	// 부모의 주소 공간은 복사하지 않고 바로 새 프로그램을 올린다
+	if (!process_load(cmd_line, &if_))
+		goto error;
+	current->load_ok = true;
+	sema_up(&current->fork_sema);
+	do_iret(&if_);
+	NOT_REACHED();
+
 error:
 	current->exit_status = -1;
 	sema_up(&current->fork_sema);
@@ -257,28 +356,13 @@ error:
  * Returns -1 on fail. */
 int process_exec(void *f_name)
 {
-	char *file_name = f_name;
-	bool success;
-
 	/* We cannot use the intr_frame in the thread structure.
 	 * This is because when current thread rescheduled,
 	 * it stores the execution information to the member. */
 	struct intr_frame _if;
-	_if.ds = _if.es = _if.ss = SEL_UDSEG;
-	_if.cs = SEL_UCSEG;
-	_if.eflags = FLAG_IF | FLAG_MBS;
 
-	/* We first kill the current context */
-	process_cleanup();
-#ifdef VM
-	supplemental_page_table_init(&thread_current()->spt);
-#endif
-	/* And then load the binary */
-	success = load(file_name, &_if);
-
-	palloc_free_page(file_name);
 	/* If load failed, quit. */
-	if (!success)
+	if (!process_load(f_name, &_if))
 	{
 		return -1;
 	}
@@ -288,6 +372,30 @@ int process_exec(void *f_name)
 	NOT_REACHED();
 }
 
+/* Replaces the current process's address space by the program and
+ * arguments in FILE_NAME, a page that is freed, and sets up _IF to
+ * start it.  Returns false if the program cannot be loaded. */
+static bool
+process_load(char *file_name, struct intr_frame *_if)
+{
+	bool success;
+
+	_if->ds = _if->es = _if->ss = SEL_UDSEG;
+	_if->cs = SEL_UCSEG;
+	_if->eflags = FLAG_IF | FLAG_MBS;
+
+	/* We first kill the current context */
+	process_cleanup();
+#ifdef VM
+	supplemental_page_table_init(&thread_current()->spt);
+#endif
+	/* And then load the binary */
+	success = load(file_name, _if);
+
+	palloc_free_page(file_name);
+	return success;
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
  * it was terminated by the kernel (i.e. killed due to an
  * exception), returns -1.  If TID is invalid or if it was not a
@@ -556,6 +664,11 @@ load(const char *file_name, struct intr_frame *if_)
 		}
 	}
 
+#ifdef VM
+	// heap은 bss 바로 뒤에서 비어 있는 채로 시작
+	vma_heap_init(&t->spt);
+#endif
+
 	/* Set up stack. */
 	if (!setup_stack(if_))
 		goto done;
@@ -775,8 +888,9 @@ install_page(void *upage, void *kpage, bool writable)
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
-static bool
-lazy_load_segment(struct page *page, struct new_aux *aux)
+static struct file_ref *lazy_aux_drop(struct new_aux *aux, bool keep_ref);
+
+bool lazy_load_segment(struct page *page, struct new_aux *aux)
 {
 	/* TODO: Load the segment from the file */
 	/* TODO: This called when the first page fault occurs on address VA. */
@@ -787,59 +901,98 @@ lazy_load_segment(struct page *page, struct new_aux *aux)
 		lock_acquire(&filesys_lock);
 		lock_acquired = true;
 	}
-	size_t page_read_bytes = aux->page_read_bytes;
-	size_t page_zero_bytes = PGSIZE - page_read_bytes;
 	struct file *file = aux->file;
-	off_t offset = aux->offset;
-	file_seek(file, offset);
 	/* Get a page of memory. */
 	uint8_t *kpage = page->frame->kva;
 	if (kpage == NULL)
 	{
+		lazy_aux_drop(aux, false);
 		if (lock_acquired)
 		{
 			lock_release(&filesys_lock);
 		}
-		free(aux);
-		file_close(file);
 		return false;
 	}
 
-	/* Load this page. */
-	int bytes_read = file_read(file, kpage, page_read_bytes);
-	if (bytes_read < 0)
+	/* Load this page, and the neighbours backed by the following
+	 * file data with the same read. */
+	if (!file_read_around(page, file, aux->offset, aux->page_read_bytes, kpage))
 	{
+		lazy_aux_drop(aux, false);
 		if (lock_acquired)
 		{
 			lock_release(&filesys_lock);
 		}
-		free(aux);
-		file_close(file);
 		return false;
 	}
-	// 파일 끝에 도달한 경우, 나머지는 0으로 채움
-	if (bytes_read < (int)page_read_bytes)
+	lazy_load_finish(page, aux);
+	if (lock_acquired)
 	{
-		memset(kpage + bytes_read, 0, page_read_bytes - bytes_read);
+		lock_release(&filesys_lock);
 	}
-	memset(kpage + page_read_bytes, 0, page_zero_bytes);
+	return true;
+}
+
+/* Finishes lazy loading PAGE, whose contents were read in from
+ * AUX: a file-backed page keeps a reference to the file.  Drops
+ * PAGE's reference to AUX. */
+void lazy_load_finish(struct page *page, struct new_aux *aux)
+{
+	bool need_lock = !lock_held_by_current_thread(&filesys_lock);
+	if (need_lock)
+		lock_acquire(&filesys_lock);
 	if (page->operations->type == VM_FILE)
 	{
-		page->file.file = file;
-		page->file.offset = offset;
-		page->file.page_read_bytes = page_read_bytes;
-		free(aux);
+		page->file.offset = aux->offset;
+		page->file.page_read_bytes = aux->page_read_bytes;
+		page->file.ref = lazy_aux_drop(aux, true);
+		page->file.file = page->file.ref->file;
 	}
 	else
+		lazy_aux_drop(aux, false);
+	if (need_lock)
+		lock_release(&filesys_lock);
+}
+
+/* Takes another reference to AUX, for a page that fork copies while
+ * it is still waiting to be loaded.  The child shares AUX, and
+ * through it the file, instead of reopening the file. */
+void lazy_aux_get(struct new_aux *aux)
+{
+	bool need_lock = !lock_held_by_current_thread(&filesys_lock);
+	if (need_lock)
+		lock_acquire(&filesys_lock);
+	aux->refs++;
+	if (need_lock)
+		lock_release(&filesys_lock);
+}
+
+/* Drops a reference to AUX, held by a page that goes away before it
+ * is loaded. */
+void lazy_aux_put(struct new_aux *aux)
+{
+	bool need_lock = !lock_held_by_current_thread(&filesys_lock);
+	if (need_lock)
+		lock_acquire(&filesys_lock);
+	lazy_aux_drop(aux, false);
+	if (need_lock)
+		lock_release(&filesys_lock);
+}
+
+/* Drops a reference to AUX, freeing it with the last one.  If
+ * KEEP_REF, first takes a reference to AUX's file for the caller
+ * and returns it, else returns NULL.  filesys_lock must be held. */
+static struct file_ref *
+lazy_aux_drop(struct new_aux *aux, bool keep_ref)
+{
+	struct file_ref *ref = keep_ref ? file_ref_get(aux->ref) : NULL;
+
+	if (--aux->refs == 0)
 	{
+		file_ref_put(aux->ref);
 		free(aux);
-		file_close(file);
 	}
-	if (lock_acquired)
-	{
-		lock_release(&filesys_lock);
-	}
-	return true;
+	return ref;
 }
 
 /* Loads a segment starting at offset OFS in FILE at address
@@ -864,43 +1017,14 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT(pg_ofs(upage) == 0);
 	ASSERT(ofs % PGSIZE == 0);
 
-	while (read_bytes > 0 || zero_bytes > 0)
-	{
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct new_aux *aux = (struct new_aux *)malloc(sizeof(struct new_aux));
-		if (aux == NULL)
-		{
-			return false;
-		}
-		struct file *reopened_file = file_reopen(file);
-		if (reopened_file == NULL)
-		{
-			free(aux); // 이전에 malloc된 aux가 있다면 해제
-			return false;
-		}
-		aux->file = reopened_file;
-		aux->offset = ofs;
-		aux->page_read_bytes = page_read_bytes;
-		if (!vm_alloc_page_with_initializer(VM_ANON, upage, writable, lazy_load_segment, aux))
-		{
-			free(aux);
-			file_close(reopened_file);
-			return false;
-		}
-
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
-		ofs += page_read_bytes; // seek를 매번 해야하니까 오프셋도 변경해야함
-	}
-	return true;
+	/* The segment becomes one region.  Read-only pages stay backed
+	 * by the file, so that processes running the same program share
+	 * them and eviction only drops them.  Each page is set up to be
+	 * loaded lazily when it is first touched, and a page with
+	 * nothing to read is zero-fill on demand. */
+	return vma_map(&thread_current()->spt, upage, read_bytes + zero_bytes,
+				   writable ? VM_ANON : VM_FILE, writable,
+				   read_bytes > 0 ? file : NULL, ofs, read_bytes) != NULL;
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
@@ -928,105 +1052,171 @@ setup_stack(struct intr_frame *if_)
 void *mmap(void *addr, size_t length, int writable, int fd, off_t offset)
 {
 	struct thread *cur = thread_current();
-	if (!addr || addr != pg_round_down(addr) || !length || fd < 0 ||
-		fd >= cur->fd_table_size || offset < 0 || offset % PGSIZE != 0)
-	{
-		return MAP_FAILED;
-	}
-	struct file *file = cur->fd_table[fd];
-	if (!file || file == STDIN || file == STDOUT)
-	{
-		return MAP_FAILED;
-	}
-	uint8_t *upage = (uint8_t *)addr;
-	uint8_t *start_page = upage;
-
-	lock_acquire(&filesys_lock);
-	off_t actual_file_length = file_length(file);
-	lock_release(&filesys_lock);
+	bool populate = (writable & MAP_POPULATE) != 0;
+	bool anonymous = (writable & MAP_ANONYMOUS) != 0;
+	struct file *file = NULL;
 
-	if (actual_file_length == 0)
+	writable &= ~(MAP_POPULATE | MAP_ANONYMOUS);
+	if (addr != pg_round_down(addr) || !length || offset < 0 || offset % PGSIZE != 0)
 	{
 		return MAP_FAILED;
 	}
-
-	while (length > 0)
+	if (anonymous)
 	{
-		if (!is_user_vaddr(upage) || spt_find_page(&cur->spt, upage))
+		// 파일 없이 0으로 채워지는 매핑: fd는 보지 않고, addr이 NULL이면 자리를 골라 준다
+		if (!addr && (addr = vma_find_free(&cur->spt, length)) == NULL)
 		{
-			goto rollback;
+			return MAP_FAILED;
 		}
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = length < PGSIZE ? length : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-		off_t remaining_file_bytes = actual_file_length - offset;
-		if (page_read_bytes > (size_t)remaining_file_bytes)
-			page_read_bytes = remaining_file_bytes;
-
-		// Break if we've reached the end of the file
-		if (page_read_bytes == 0)
-			break;
-
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct new_aux *aux = (struct new_aux *)malloc(sizeof(struct new_aux));
-		if (aux == NULL)
+	}
+	else
+	{
+		if (!addr || fd < 0 || fd >= cur->fd_table_size)
 		{
-			goto rollback;
+			return MAP_FAILED;
 		}
-		struct file *reopened_file = file_reopen(file);
-		if (reopened_file == NULL)
+		file = cur->fd_table[fd];
+		if (!file || file == STDIN || file == STDOUT)
 		{
-			free(aux); // 이전에 malloc된 aux가 있다면 해제
-			goto rollback;
+			return MAP_FAILED;
 		}
-		aux->file = reopened_file;
-		aux->offset = offset;
-		aux->page_read_bytes = page_read_bytes;
-		if (!vm_alloc_page_with_initializer(VM_FILE, upage, writable, lazy_load_segment, aux))
+		lock_acquire(&filesys_lock);
+		off_t actual_file_length = file_length(file);
+		lock_release(&filesys_lock);
+
+		// 파일 끝을 넘는 부분은 매핑하지 않는다
+		if (offset >= actual_file_length)
 		{
-			free(aux);
-			file_close(reopened_file);
-			goto rollback;
+			return MAP_FAILED;
 		}
+		if (length > (size_t)(actual_file_length - offset))
+			length = actual_file_length - offset;
+	}
 
-		spt_find_page(&cur->spt, upage)->mapped_page_count = 0;
-		/* Advance. */
-		length -= page_read_bytes;
-		upage += PGSIZE;
-		offset += page_read_bytes; // seek를 매번 해야하니까 오프셋도 변경해야함
-
-		struct page *fir_page = spt_find_page(&cur->spt, addr);
-		fir_page->mapped_page_count++;
+	/* The whole range must be free user memory.  Its pages are only
+	 * created when they are touched. */
+	void *end = (uint8_t *)addr + ROUND_UP(length, PGSIZE);
+	if (end < addr || !is_user_vaddr(end - 1) || !vma_range_free(&cur->spt, addr, end))
+	{
+		return MAP_FAILED;
+	}
+	struct vma *vma = anonymous
+						  ? vma_map(&cur->spt, addr, length, VM_ANON, writable, NULL, 0, 0)
+						  : vma_map(&cur->spt, addr, length, VM_FILE, writable, file, offset, length);
+	if (vma == NULL)
+	{
+		return MAP_FAILED;
+	}
+	vma->mmapped = true;
+	if (populate)
+	{
+		// 한 번의 순차 접근으로 보고 가장 큰 fault-around로 읽는다
+		vma->advice = VMA_ADV_SEQUENTIAL;
+		vm_populate(addr, end);
+		vma->advice = VMA_ADV_NORMAL;
 	}
 	return addr;
-rollback:
-	// 실패 시 이미 할당한 페이지들 정리
-	munmap(start_page);
-	return MAP_FAILED;
 }
 
 void munmap(void *addr)
 {
-	if (!addr)
-		return;
 	struct supplemental_page_table *spt = &thread_current()->spt;
-	struct page *page = spt_find_page(spt, addr);
-	if (!page)
-		return;
+	struct vma *vma = vma_find(spt, addr);
 
-	int count = page->mapped_page_count;
-	for (int i = 0; i < count; i++)
+	// mmap으로 만든 region의 시작 주소여야 한다 (write-back은 destroy가 처리)
+	if (vma == NULL || !vma->mmapped || vma->start != addr || vma->split)
+		return;
+	// madvise로 나뉜 뒷부분도 함께 내린다
+	for (;;)
 	{
-		page = spt_find_page(spt, addr);
-		if (!page)
+		void *end = vma->end;
+
+		vma_unmap(spt, vma);
+		vma = vma_find(spt, end);
+		if (vma == NULL || !vma->split || vma->start != end)
 			break;
+	}
+}
 
-		// Let destroy handle write-back and file closing
-		spt_remove_page(spt, page);
-		addr += PGSIZE;
+/* Applies ADVICE to the pages in the LENGTH bytes at ADDR, which must
+ * be page aligned.  Returns 0, or -1 if the arguments are bad or
+ * memory ran out. */
+int madvise(void *addr, size_t length, int advice)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	void *end = (uint8_t *)addr + ROUND_UP(length, PGSIZE);
+
+	if (addr != pg_round_down(addr) || end < addr || (end > addr && !is_user_vaddr(end - 1)))
+		return -1;
+	switch (advice)
+	{
+	case MADV_NORMAL:
+		return vma_advise(spt, addr, end, VMA_ADV_NORMAL) ? 0 : -1;
+	case MADV_RANDOM:
+		return vma_advise(spt, addr, end, VMA_ADV_RANDOM) ? 0 : -1;
+	case MADV_SEQUENTIAL:
+		return vma_advise(spt, addr, end, VMA_ADV_SEQUENTIAL) ? 0 : -1;
+	case MADV_WILLNEED:
+		vm_prefetch(addr, end);
+		return 0;
+	case MADV_DONTNEED:
+		vm_discard(addr, end);
+		return 0;
+	default:
+		return -1;
 	}
 }
+
+/* Writes the dirty pages of file mappings in the LENGTH bytes at
+ * ADDR, which must be page aligned, back to their files.  With
+ * MS_SYNC they are written before returning; with MS_ASYNC they are
+ * left to the writeback thread, which writes every dirty page soon
+ * anyway.  Returns 0, or -1 if the arguments are bad. */
+int msync(void *addr, size_t length, int flags)
+{
+	void *end = (uint8_t *)addr + ROUND_UP(length, PGSIZE);
+
+	if (addr != pg_round_down(addr) || end < addr || (end > addr && !is_user_vaddr(end - 1)))
+		return -1;
+	if ((flags & ~(MS_ASYNC | MS_SYNC)) != 0 || flags == (MS_ASYNC | MS_SYNC))
+		return -1;
+	if (flags & MS_SYNC)
+		vm_sync(addr, end);
+	return 0;
+}
+
+/* Locks the pages that hold the LENGTH bytes at ADDR in memory.
+ * Returns 0, or -1 if part of the range is not mapped, the process
+ * would lock more pages than it may, or memory ran out. */
+int mlock(const void *addr, size_t length)
+{
+	void *start = pg_round_down(addr);
+	void *end = (void *)ROUND_UP((uint64_t)addr + length, PGSIZE);
+
+	if (end < start || (end > start && !is_user_vaddr(end - 1)))
+		return -1;
+	return vm_mlock(start, end) ? 0 : -1;
+}
+
+/* Unlocks the pages that hold the LENGTH bytes at ADDR.  Returns 0,
+ * or -1 if the range is not in user memory. */
+int munlock(const void *addr, size_t length)
+{
+	void *start = pg_round_down(addr);
+	void *end = (void *)ROUND_UP((uint64_t)addr + length, PGSIZE);
+
+	if (end < start || (end > start && !is_user_vaddr(end - 1)))
+		return -1;
+	vm_munlock(start, end);
+	return 0;
+}
+
+/* Moves the current process's program break to ADDR, growing or
+ * shrinking its heap, and returns the new break.  Returns the current
+ * break, changing nothing, if the heap cannot be moved there, so
+ * brk(NULL) asks for the current break. */
+void *brk(void *addr)
+{
+	return vma_brk(&thread_current()->spt, addr);
+}
 #endif /* VM */
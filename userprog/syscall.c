@@ -31,6 +31,7 @@ static void s_halt(void) NO_RETURN;
 void s_exit(int status) NO_RETURN;
 static int s_fork(const char *thread_name, struct intr_frame *f);
 static int s_exec(const char *file);
+static int s_spawn(const char *cmd_line);
 static int s_wait(pid_t);
 static bool s_create(const char *file, unsigned initial_size);
 static bool s_remove(const char *file);
@@ -135,6 +136,21 @@ void syscall_handler(struct intr_frame *f)
 	case SYS_MUNMAP:
 		munmap(f->R.rdi);
 		break;
+	case SYS_MADVISE:
+		f->R.rax = madvise((void *)f->R.rdi, f->R.rsi, f->R.rdx);
+		break;
+	case SYS_MSYNC:
+		f->R.rax = msync((void *)f->R.rdi, f->R.rsi, f->R.rdx);
+		break;
+	case SYS_MLOCK:
+		f->R.rax = mlock((const void *)f->R.rdi, f->R.rsi);
+		break;
+	case SYS_MUNLOCK:
+		f->R.rax = munlock((const void *)f->R.rdi, f->R.rsi);
+		break;
+	case SYS_BRK:
+		f->R.rax = brk((void *)f->R.rdi);
+		break;
 		// /* Project 4 only. */
 		// case SYS_CHDIR:
 		// 	break;
@@ -152,6 +168,9 @@ void syscall_handler(struct intr_frame *f)
 	case SYS_DUP2:
 		f->R.rax = s_dup2(f->R.rdi, f->R.rsi);
 		break;
+	case SYS_SPAWN:
+		f->R.rax = s_spawn((const char *)f->R.rdi);
+		break;
 		// case SYS_MOUNT:
 		// 	break;
 		// case SYS_UMOUNT:
@@ -216,6 +235,30 @@ static int s_exec(const char *file)
 	return res;
 }
 
+/* fork와 exec를 한 번에: 부모의 주소 공간을 복사하지 않는다 */
+static int s_spawn(const char *cmd_line)
+{
+	s_check_access(cmd_line);
+
+	tid_t child_tid = process_spawn(cmd_line);
+	if (child_tid == TID_ERROR)
+		return TID_ERROR;
+
+	struct thread *child = get_thread_by_tid(child_tid);
+	if (child == NULL)
+		return TID_ERROR;
+
+	sema_down(&child->fork_sema);
+
+	// 프로그램을 올리지 못한 자식은 여기서 거둔다 (올린 뒤 exit(-1)한 자식과 구분)
+	if (!child->load_ok)
+	{
+		process_wait(child_tid);
+		return TID_ERROR;
+	}
+	return child_tid;
+}
+
 static int s_wait(int tid)
 {
 	return process_wait(tid);
@@ -289,9 +332,13 @@ static int s_filesize(int fd)
 
 static int s_read(int fd, void *buffer, unsigned length)
 {
+#ifdef VM
+	// 커널이 buffer에 쓰는 동안 ksmd가 페이지를 다시 공유하지 않도록
+	thread_current()->spt.pin_cnt++;
+#endif
 	s_check_writable_buffer(buffer, length);
 	s_check_fd(fd);
-	int bytes_read = 0;
+	int bytes_read = -1;
 
 	// 3. 파일 디스크립터에서 파일 찾기
 	struct file *f = thread_current()->fd_table[fd];
@@ -301,16 +348,18 @@ static int s_read(int fd, void *buffer, unsigned length)
 		for (unsigned i = 0; i < length; i++)
 			((uint8_t *)buffer)[i] = input_getc();
 		lock_release(&filesys_lock);
-		return length;
+		bytes_read = length;
 	}
-	if (f == NULL || f == STDOUT)
-		return -1;
-
-	// 4. 파일 읽기
-	lock_acquire(&filesys_lock);
-	bytes_read = file_read(f, buffer, length);
-	lock_release(&filesys_lock);
-
+	else if (f != NULL && f != STDOUT)
+	{
+		// 4. 파일 읽기
+		lock_acquire(&filesys_lock);
+		bytes_read = file_read(f, buffer, length);
+		lock_release(&filesys_lock);
+	}
+#ifdef VM
+	thread_current()->spt.pin_cnt--;
+#endif
 	return bytes_read;
 }
 
@@ -480,6 +529,11 @@ static void s_check_writable_buffer(void *buffer, unsigned length)
 		{
 			s_exit(-1);
 		}
+		// 커널은 read-only 매핑을 무시하므로 공유 frame에 쓰기 전에 분리
+		if (page && !vm_unshare_page(page))
+		{
+			s_exit(-1);
+		}
 #endif
 	}
 }
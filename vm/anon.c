@@ -1,14 +1,116 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include "vm/zswap.h"
+#include <ctype.h>
+#include <round.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "devices/disk.h"
 #include "lib/kernel/bitmap.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "threads/mmu.h"
 
+/* Number of swap disk sectors that hold one page. */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Maximum number of swap devices: every disk Pintos supports. */
+#define SWAP_DEV_MAX 4
+
+/* Slots per swap cluster (256 kB).  A process fills a cluster of
+   free slots before it moves on to another one, so its pages stay
+   together on disk.  Also the unit of striping across devices. */
+#define SWAP_CLUSTER_SLOTS 64
+
+/* A swap device.  Its slots are numbered BASE...BASE+size-1 in
+   the global swap slot space kept in anon_page.swap_index. */
+struct swap_device
+{
+	struct disk *disk;
+	struct bitmap *slots; /* In-use slots. */
+	size_t base;		  /* Global number of the first slot. */
+	size_t used;		  /* Number of slots in use. */
+	size_t cursor;		  /* Next-fit: where the next search starts. */
+	int prio;			  /* Higher priority devices fill up first. */
+	long long in_cnt;	  /* Pages swapped in. */
+	long long out_cnt;	  /* Pages swapped out. */
+};
+
+/* -swap: devices to swap to, "hdC:D[@PRIO],...". */
+const char *swap_devices_option = "hd1:1";
+
+static struct swap_device swap_devs[SWAP_DEV_MAX];
+static size_t swap_dev_cnt;
+static size_t swap_rotor;	  /* Device to try first on the next swap-out. */
+static struct lock swap_lock; /* Protects the above. */
+
+/* Swap readahead.  On a swap-in fault the slots of the following
+   virtual pages are read too, into the swap cache, and copied from
+   there when those pages fault.  The window grows by one page on
+   every cache hit and halves whenever a cached page goes unused. */
+#define SWAP_RA_MAX 16	  /* Largest readahead window, in pages. */
+#define SWAP_CACHE_MAX 32 /* Most pages kept in the swap cache. */
+
+/* A swap slot read ahead of its page's fault. */
+struct swap_cache_entry
+{
+	size_t slot;			 /* Global swap slot. */
+	void *kva;				 /* Copy of the slot's contents. */
+	struct disk_request req; /* Read of the slot. */
+	struct semaphore done;	 /* Upped when the read finishes. */
+	struct list_elem elem;	 /* swap_cache element. */
+};
+
+/* Protected by swap_lock. */
+static struct list swap_cache; /* Oldest first. */
+static size_t swap_cache_cnt;
+static size_t swap_ra_window = 4;
+static struct supplemental_page_table *swap_ra_last_spt; /* Last swap-in, */
+static void *swap_ra_last_va;							 /*   to spot streams. */
+static long long swap_ra_cnt;							 /* Pages read ahead. */
+static long long swap_ra_hit_cnt;						 /* ...later used. */
+static long long swap_ra_waste_cnt;						 /* ...dropped unused. */
+
+/* A swap slot that fork made several pages share.  Slots used by a
+   single page have no entry.  The first sharer to fault reads the
+   slot in and leaves its frame here, and the others map that frame
+   copy-on-write instead of reading the slot again.  The slot is
+   freed when the last sharer has let go of it. */
+struct swap_share
+{
+	struct hash_elem elem;
+	size_t slot;		 /* Global swap slot. */
+	int refs;			 /* Pages that still hold the slot. */
+	struct frame *frame; /* Slot's contents in memory, or NULL. */
+};
+
+/* Protected by swap_lock. */
+static struct hash swap_shares;
+static long long swap_share_cnt;	  /* Slots shared by fork. */
+static long long swap_share_hit_cnt; /* Faults served without a read. */
+
+static bool swap_add_device(const char *spec);
+static struct swap_device *swap_pick_device(void);
+static struct swap_device *swap_slot_device(size_t slot);
+static size_t swap_alloc_slot(struct swap_cluster *cluster);
+static size_t swap_find_cluster(struct swap_device *sd);
+static void swap_free_slot(size_t slot);
+static bool swap_put_slot(size_t slot, struct frame *frame);
+static struct swap_share *swap_share_find(size_t slot);
+static uint64_t swap_share_hash(const struct hash_elem *e, void *aux);
+static bool swap_share_less(const struct hash_elem *a, const struct hash_elem *b,
+							void *aux);
+static void swap_io_done(struct disk_request *req);
+static void swap_readahead(struct page *page);
+static bool swap_cache_add(struct swap_device *sd, size_t slot);
+static struct swap_cache_entry *swap_cache_take(size_t slot);
+static void swap_cache_free(struct swap_cache_entry *e, void *kva);
+
 /* DO NOT MODIFY BELOW LINE */
-static struct disk *swap_disk;
-static struct bitmap *swap_table;
 static bool anon_swap_in(struct page *page, void *kva);
 static bool anon_swap_out(struct page *page);
 static void anon_destroy(struct page *page);
@@ -24,22 +126,523 @@ static const struct page_operations anon_ops = {
 /* Initialize the data for anonymous pages */
 void vm_anon_init(void)
 {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = disk_get(1, 1);
-	if (swap_disk == NULL)
+	char specs[64];
+	char *spec, *save_ptr;
+
+	lock_init(&swap_lock);
+	list_init(&swap_cache);
+	hash_init(&swap_shares, swap_share_hash, swap_share_less, NULL);
+	zswap_init();
+
+	strlcpy(specs, swap_devices_option, sizeof specs);
+	for (spec = strtok_r(specs, ",", &save_ptr); spec != NULL;
+		 spec = strtok_r(NULL, ",", &save_ptr))
+		if (!swap_add_device(spec))
+			printf("swap: ignoring `%s'\n", spec);
+}
+
+/* Adds the disk named by SPEC, "hdC:D" optionally followed by
+   "@PRIO", as a swap device.  Returns false if SPEC is malformed
+   or names a missing, duplicate, or too small disk. */
+static bool
+swap_add_device(const char *spec)
+{
+	struct swap_device *sd;
+	struct disk *d;
+	size_t i;
+	int prio = 0;
+
+	if (swap_dev_cnt >= SWAP_DEV_MAX || spec[0] != 'h' || spec[1] != 'd' || !isdigit(spec[2]) || spec[3] != ':' || !isdigit(spec[4]) || (spec[5] != '\0' && spec[5] != '@'))
+		return false;
+	if (spec[5] == '@')
+		prio = atoi(spec + 6);
+
+	d = disk_get(spec[2] - '0', spec[4] - '0');
+	if (d == NULL || disk_size(d) < SECTORS_PER_PAGE)
+		return false;
+	for (i = 0; i < swap_dev_cnt; i++)
+		if (swap_devs[i].disk == d)
+			return false;
+
+	sd = &swap_devs[swap_dev_cnt];
+	sd->disk = d;
+	// 1 sector = 512 bytes, 1 page = 4096 bytes = 8 sectors
+	sd->slots = bitmap_create(disk_size(d) / SECTORS_PER_PAGE);
+	if (sd->slots == NULL)
+		PANIC("swap_table creation failed");
+	sd->base = swap_dev_cnt > 0 ? sd[-1].base + bitmap_size(sd[-1].slots) : 0;
+	sd->used = 0;
+	sd->cursor = 0;
+	sd->prio = prio;
+	sd->in_cnt = sd->out_cnt = 0;
+	swap_dev_cnt++;
+	return true;
+}
+
+/* Returns the device to start the next swap cluster on, or a null
+   pointer if every device is full.  Among the non-full devices
+   with the highest priority, takes turns starting at swap_rotor,
+   so that consecutive clusters are striped across them and can be
+   written and read back in parallel when they sit on different
+   channels.  swap_lock must be held. */
+static struct swap_device *
+swap_pick_device(void)
+{
+	struct swap_device *pick = NULL;
+	size_t i;
+
+	for (i = 0; i < swap_dev_cnt; i++)
+	{
+		struct swap_device *sd = &swap_devs[(swap_rotor + i) % swap_dev_cnt];
+		if (sd->used < bitmap_size(sd->slots) && (pick == NULL || sd->prio > pick->prio))
+			pick = sd;
+	}
+	if (pick != NULL)
+		swap_rotor = (pick - swap_devs) + 1;
+	return pick;
+}
+
+/* Returns the device that holds global swap slot SLOT. */
+static struct swap_device *
+swap_slot_device(size_t slot)
+{
+	size_t i;
+
+	for (i = 0; i < swap_dev_cnt; i++)
+	{
+		struct swap_device *sd = &swap_devs[i];
+		if (slot >= sd->base && slot < sd->base + bitmap_size(sd->slots))
+			return sd;
+	}
+	NOT_REACHED();
+}
+
+/* Allocates a swap slot for a page whose owner swaps out through
+   CLUSTER and returns its global number, or BITMAP_ERROR if swap
+   is full.  Continues CLUSTER if its next slot is still free,
+   otherwise starts a new cluster at the first wholly free one
+   after the device's cursor, and falls back to any free slot only
+   when there is none.  swap_lock must be held. */
+static size_t
+swap_alloc_slot(struct swap_cluster *cluster)
+{
+	struct swap_device *sd;
+	size_t slot;
+
+	if (cluster->next < cluster->end)
+	{
+		sd = swap_slot_device(cluster->next);
+		slot = cluster->next - sd->base;
+		if (!bitmap_test(sd->slots, slot))
+			goto found;
+	}
+
+	sd = swap_pick_device();
+	if (sd == NULL)
+		return BITMAP_ERROR;
+	slot = swap_find_cluster(sd);
+	if (slot != BITMAP_ERROR)
+	{
+		size_t size = bitmap_size(sd->slots);
+		cluster->end = sd->base + (slot + SWAP_CLUSTER_SLOTS < size ? slot + SWAP_CLUSTER_SLOTS : size);
+	}
+	else
+	{
+		// 빈 cluster가 없으면 cursor부터 아무 빈 slot이나 사용
+		slot = bitmap_scan(sd->slots, sd->cursor, 1, false);
+		if (slot == BITMAP_ERROR)
+			slot = bitmap_scan(sd->slots, 0, 1, false);
+		ASSERT(slot != BITMAP_ERROR);
+		cluster->end = 0;
+	}
+
+found:
+	bitmap_mark(sd->slots, slot);
+	sd->used++;
+	sd->cursor = slot + 1 < bitmap_size(sd->slots) ? slot + 1 : 0;
+	cluster->next = sd->base + slot + 1;
+	return sd->base + slot;
+}
+
+/* Returns the first slot of the first cluster of SD at or after
+   its cursor, wrapping around, whose slots are all free, or
+   BITMAP_ERROR if there is none.  swap_lock must be held. */
+static size_t
+swap_find_cluster(struct swap_device *sd)
+{
+	size_t size = bitmap_size(sd->slots);
+	size_t cluster_cnt = DIV_ROUND_UP(size, SWAP_CLUSTER_SLOTS);
+	size_t first = DIV_ROUND_UP(sd->cursor, SWAP_CLUSTER_SLOTS);
+	size_t i;
+
+	for (i = 0; i < cluster_cnt; i++)
+	{
+		size_t start = (first + i) % cluster_cnt * SWAP_CLUSTER_SLOTS;
+		size_t cnt = size - start < SWAP_CLUSTER_SLOTS ? size - start : SWAP_CLUSTER_SLOTS;
+		if (bitmap_none(sd->slots, start, cnt))
+			return start;
+	}
+	return BITMAP_ERROR;
+}
+
+/* Marks global swap slot SLOT free, dropping any copy of it from
+   the swap cache and the compressed swap cache. */
+static void
+swap_free_slot(size_t slot)
+{
+	struct swap_device *sd;
+	struct swap_cache_entry *e;
+
+	lock_acquire(&swap_lock);
+	sd = swap_slot_device(slot);
+	bitmap_reset(sd->slots, slot - sd->base);
+	sd->used--;
+	e = swap_cache_take(slot);
+	lock_release(&swap_lock);
+
+	if (e != NULL)
+		swap_cache_free(e, NULL);
+	zswap_invalidate(slot);
+}
+
+/* Makes PAGE, the copy of SRC made by fork, share SRC's swap slot.
+   Returns false if out of memory. */
+bool anon_share_slot(struct page *page, struct page *src)
+{
+	size_t slot = src->anon.swap_index;
+	struct swap_share *s, *new_s;
+
+	new_s = malloc(sizeof *new_s);
+	if (new_s == NULL)
+		return false;
+
+	lock_acquire(&swap_lock);
+	s = swap_share_find(slot);
+	if (s == NULL)
+	{
+		s = new_s;
+		s->slot = slot;
+		s->refs = 1;
+		s->frame = NULL;
+		hash_insert(&swap_shares, &s->elem);
+		swap_share_cnt++;
+		new_s = NULL;
+	}
+	s->refs++;
+	lock_release(&swap_lock);
+
+	free(new_s);
+	page->anon.swap_index = slot;
+	return true;
+}
+
+/* If PAGE is a swapped out anonymous page whose slot another page
+   has already read back in, maps PAGE read-only to that frame and
+   returns true.  A write copies it through vm_handle_wp(). */
+bool anon_share_map(struct page *page)
+{
+	struct swap_share *s;
+	struct frame *frame = NULL;
+	size_t slot;
+
+	if (page->operations != &anon_ops || page->frame != NULL || page->anon.swap_index == -1)
+		return false;
+	slot = page->anon.swap_index;
+
+	lock_acquire(&swap_lock);
+	s = swap_share_find(slot);
+	if (s != NULL && s->frame != NULL)
+	{
+		frame = s->frame;
+		vm_share_frame(page, frame);
+		swap_share_hit_cnt++;
+	}
+	lock_release(&swap_lock);
+	if (frame == NULL)
+		return false;
+
+	page->anon.swap_index = -1;
+	swap_put_slot(slot, NULL);
+	return pml4_set_page(page->pml4, page->va, frame->kva, false);
+}
+
+/* Drops a page's hold on global swap slot SLOT, whose contents the
+   page no longer needs, and frees the slot if no other page shares
+   it.  If others do and FRAME, which holds the slot's contents, is
+   non-null, keeps a reference to FRAME for them unless another
+   frame is kept already, and returns true.  The caller must then
+   map FRAME read-only. */
+static bool
+swap_put_slot(size_t slot, struct frame *frame)
+{
+	struct swap_share *s;
+	struct frame *old = NULL;
+	bool kept = false;
+
+	lock_acquire(&swap_lock);
+	s = swap_share_find(slot);
+	if (s != NULL && --s->refs > 0)
+	{
+		if (frame != NULL && s->frame == NULL)
+		{
+			vm_ref_frame(frame);
+			s->frame = frame;
+			kept = true;
+		}
+		lock_release(&swap_lock);
+		return kept;
+	}
+	if (s != NULL)
+	{
+		hash_delete(&swap_shares, &s->elem);
+		old = s->frame;
+	}
+	lock_release(&swap_lock);
+
+	if (old != NULL)
+		vm_unref_frame(old);
+	free(s);
+	swap_free_slot(slot);
+	return false;
+}
+
+/* Returns the sharing entry for global swap slot SLOT, or a null
+   pointer if only one page uses it.  swap_lock must be held. */
+static struct swap_share *
+swap_share_find(size_t slot)
+{
+	struct swap_share key;
+	struct hash_elem *e;
+
+	key.slot = slot;
+	e = hash_find(&swap_shares, &key.elem);
+	return e != NULL ? hash_entry(e, struct swap_share, elem) : NULL;
+}
+
+static uint64_t
+swap_share_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	const struct swap_share *s = hash_entry(e, struct swap_share, elem);
+	return hash_bytes(&s->slot, sizeof s->slot);
+}
+
+static bool
+swap_share_less(const struct hash_elem *a, const struct hash_elem *b,
+				void *aux UNUSED)
+{
+	return hash_entry(a, struct swap_share, elem)->slot < hash_entry(b, struct swap_share, elem)->slot;
+}
+
+/* disk_done_func for swap I/O: ups the semaphore in REQ->aux. */
+static void
+swap_io_done(struct disk_request *req)
+{
+	sema_up(req->aux);
+}
+
+/* Starts reading the swap slots of the pages that follow PAGE in
+   its owner's address space into the swap cache, up to the
+   readahead window.  Stops at the first page that is not a
+   swapped out anonymous page, and skips pages held compressed in
+   memory.  Does not wait for the reads.  Regions advised with
+   MADV_RANDOM get no readahead and MADV_SEQUENTIAL ones the
+   largest window.  Looks neighbours up without creating the pages
+   of untouched region addresses. */
+static void
+swap_readahead(struct page *page)
+{
+	size_t window, i;
+
+	lock_acquire(&swap_lock);
+	window = swap_ra_window;
+	lock_release(&swap_lock);
+	switch (vma_advice_at(page->spt, page->va))
 	{
+	case VMA_ADV_RANDOM:
 		return;
+	case VMA_ADV_SEQUENTIAL:
+		window = SWAP_RA_MAX;
+		break;
+	default:
+		break;
 	}
-	// swap disk의 크기를 페이지 단위로 계산
-	// 1 sector = 512 bytes, 1 page = 4096 bytes = 8 sectors
-	size_t swap_size = disk_size(swap_disk) / 8;
-	swap_table = bitmap_create(swap_size);
-	if (swap_table == NULL)
+
+	for (i = 1; i <= window; i++)
 	{
-		PANIC("swap_table creation failed");
+		struct page *p = spt_peek_page(page->spt, page->va + i * PGSIZE);
+		struct swap_device *sd;
+
+		if (p == NULL || p->operations != &anon_ops || p->frame != NULL || p->anon.swap_index == -1)
+			break;
+		if (zswap_contains(p->anon.swap_index))
+			continue;
+		lock_acquire(&swap_lock);
+		sd = swap_slot_device(p->anon.swap_index);
+		lock_release(&swap_lock);
+		if (!swap_cache_add(sd, p->anon.swap_index))
+			break;
 	}
 }
 
+/* If PAGE is a swapped out anonymous page, starts reading it into
+   the swap cache, as madvise(MADV_WILLNEED) asks, without waiting
+   for the read, and returns true.  Otherwise returns false. */
+bool anon_prefetch(struct page *page)
+{
+	struct swap_device *sd;
+
+	if (page->operations != &anon_ops || page->frame != NULL || page->anon.swap_index == (size_t)-1)
+		return false;
+	if (zswap_contains(page->anon.swap_index))
+		return true;
+	lock_acquire(&swap_lock);
+	sd = swap_slot_device(page->anon.swap_index);
+	lock_release(&swap_lock);
+	swap_cache_add(sd, page->anon.swap_index);
+	return true;
+}
+
+/* Starts reading global swap slot SLOT, on device SD, into the
+   swap cache, unless it is already there.  Makes room by dropping
+   the oldest entry if the cache is full.  Returns false if no
+   memory is free for the copy. */
+static bool
+swap_cache_add(struct swap_device *sd, size_t slot)
+{
+	struct swap_cache_entry *e, *victim = NULL;
+	struct list_elem *el;
+
+	// 이미 cache에 있으면 다시 읽지 않는다
+	lock_acquire(&swap_lock);
+	for (el = list_begin(&swap_cache); el != list_end(&swap_cache); el = list_next(el))
+		if (list_entry(el, struct swap_cache_entry, elem)->slot == slot)
+		{
+			lock_release(&swap_lock);
+			return true;
+		}
+	lock_release(&swap_lock);
+
+	// readahead를 위해 다른 페이지를 evict하지는 않는다
+	e = malloc(sizeof *e);
+	if (e == NULL)
+		return false;
+	e->kva = palloc_get_page(PAL_USER);
+	if (e->kva == NULL)
+	{
+		free(e);
+		return false;
+	}
+	e->slot = slot;
+	sema_init(&e->done, 0);
+	disk_request_init(&e->req, sd->disk, (slot - sd->base) * SECTORS_PER_PAGE,
+					  e->kva, SECTORS_PER_PAGE, false, swap_io_done, &e->done);
+
+	lock_acquire(&swap_lock);
+	if (swap_cache_cnt >= SWAP_CACHE_MAX)
+	{
+		victim = list_entry(list_pop_front(&swap_cache), struct swap_cache_entry, elem);
+		swap_cache_cnt--;
+	}
+	list_push_back(&swap_cache, &e->elem);
+	swap_cache_cnt++;
+	swap_ra_cnt++;
+	lock_release(&swap_lock);
+
+	disk_submit(&e->req);
+	if (victim != NULL)
+		swap_cache_free(victim, NULL);
+	return true;
+}
+
+/* Removes the swap cache entry for global swap slot SLOT and
+   returns it, or returns a null pointer if there is none.
+   swap_lock must be held. */
+static struct swap_cache_entry *
+swap_cache_take(size_t slot)
+{
+	struct list_elem *el;
+
+	for (el = list_begin(&swap_cache); el != list_end(&swap_cache); el = list_next(el))
+	{
+		struct swap_cache_entry *e = list_entry(el, struct swap_cache_entry, elem);
+		if (e->slot == slot)
+		{
+			list_remove(el);
+			swap_cache_cnt--;
+			return e;
+		}
+	}
+	return NULL;
+}
+
+/* Waits for the read of E, which has been taken out of the swap
+   cache, copies the data to KVA if it is non-null, and frees E.
+   A copy means E's page faulted, which widens the readahead
+   window; otherwise E went unused and the window shrinks. */
+static void
+swap_cache_free(struct swap_cache_entry *e, void *kva)
+{
+	sema_down(&e->done);
+	if (kva != NULL)
+		memcpy(kva, e->kva, PGSIZE);
+	palloc_free_page(e->kva);
+	free(e);
+
+	lock_acquire(&swap_lock);
+	if (kva != NULL)
+	{
+		swap_ra_hit_cnt++;
+		if (swap_ra_window < SWAP_RA_MAX)
+			swap_ra_window++;
+	}
+	else
+	{
+		swap_ra_waste_cnt++;
+		swap_ra_window /= 2;
+	}
+	lock_release(&swap_lock);
+}
+
+/* Frees the oldest page in the swap cache, to make room for a
+   frame.  Returns false if the cache is empty. */
+bool swap_cache_reclaim(void)
+{
+	struct swap_cache_entry *e = NULL;
+
+	lock_acquire(&swap_lock);
+	if (!list_empty(&swap_cache))
+	{
+		e = list_entry(list_pop_front(&swap_cache), struct swap_cache_entry, elem);
+		swap_cache_cnt--;
+	}
+	lock_release(&swap_lock);
+
+	if (e == NULL)
+		return false;
+	swap_cache_free(e, NULL);
+	return true;
+}
+
+/* Prints per-device swap usage statistics. */
+void swap_print_stats(void)
+{
+	size_t i;
+
+	for (i = 0; i < swap_dev_cnt; i++)
+	{
+		struct swap_device *sd = &swap_devs[i];
+		printf("Swap %s: %zu of %zu slots used (priority %d), %lld in, %lld out\n",
+			   disk_name(sd->disk), sd->used, bitmap_size(sd->slots), sd->prio,
+			   sd->in_cnt, sd->out_cnt);
+	}
+	if (swap_share_cnt > 0)
+		printf("Swap sharing: %lld slots shared by fork, %lld faults served from memory\n",
+			   swap_share_cnt, swap_share_hit_cnt);
+	if (swap_ra_cnt > 0)
+		printf("Swap readahead: %lld pages read, %lld hits, %lld wasted, window %zu\n",
+			   swap_ra_cnt, swap_ra_hit_cnt, swap_ra_waste_cnt, swap_ra_window);
+}
+
 /* Initialize the file mapping */
 bool anon_initializer(struct page *page, enum vm_type type, void *kva)
 {
@@ -56,6 +659,8 @@ static bool
 anon_swap_in(struct page *page, void *kva)
 {
 	struct anon_page *anon_page = &page->anon;
+	struct swap_device *sd;
+	struct swap_cache_entry *e;
 
 	if (anon_page->swap_index == -1)
 	{
@@ -64,14 +669,48 @@ anon_swap_in(struct page *page, void *kva)
 		return true;
 	}
 
-	// swap disk에서 페이지 읽기 (1 page = 8 sectors)
-	for (int i = 0; i < 8; i++)
+	lock_acquire(&swap_lock);
+	sd = swap_slot_device(anon_page->swap_index);
+	sd->in_cnt++;
+	e = swap_cache_take(anon_page->swap_index);
+	/* A window closed by waste reopens when the owner streams
+	   through its pages again. */
+	if (e == NULL && swap_ra_window == 0 && swap_ra_last_spt == page->spt && swap_ra_last_va + PGSIZE == page->va)
+		swap_ra_window = 1;
+	swap_ra_last_spt = page->spt;
+	swap_ra_last_va = page->va;
+	lock_release(&swap_lock);
+
+	if (e != NULL)
+	{
+		// readahead로 이미 읽어 둔 페이지: I/O 없이 복사
+		swap_cache_free(e, kva);
+		swap_readahead(page);
+	}
+	else if (zswap_load(anon_page->swap_index, kva))
+	{
+		// 압축된 채로 메모리에 있던 페이지: disk I/O 없음
+		swap_readahead(page);
+	}
+	else
 	{
-		disk_read(swap_disk, anon_page->swap_index * 8 + i, kva + i * DISK_SECTOR_SIZE);
+		struct disk_request req;
+		struct semaphore done;
+
+		// swap disk에서 페이지 읽기 (1 page = 8 sectors, 한 번의 명령으로)
+		// 기다리는 동안 다음 페이지들도 미리 읽도록 요청
+		sema_init(&done, 0);
+		disk_request_init(&req, sd->disk, (anon_page->swap_index - sd->base) * SECTORS_PER_PAGE,
+						  kva, SECTORS_PER_PAGE, false, swap_io_done, &done);
+		disk_submit(&req);
+		swap_readahead(page);
+		sema_down(&done);
 	}
 
 	// swap table에서 해당 슬롯 해제
-	bitmap_set(swap_table, anon_page->swap_index, false);
+	// fork로 공유된 슬롯이면 다른 페이지들이 이 frame을 COW로 쓰도록 남긴다
+	if (swap_put_slot(anon_page->swap_index, page->frame))
+		pml4_set_page(page->pml4, page->va, kva, false);
 	anon_page->swap_index = -1;
 
 	return true;
@@ -82,28 +721,118 @@ static bool
 anon_swap_out(struct page *page)
 {
 	struct anon_page *anon_page = &page->anon;
+	struct swap_device *sd;
+	size_t swap_index;
+
+	// 쓰는 동안 들어온 변경을 잃지 않도록 매핑부터 내린다
+	pml4_clear_page(page->pml4, page->va);
 
-	// swap table에서 빈 슬롯 찾기
-	size_t swap_index = bitmap_scan(swap_table, 0, 1, false);
+	// 주인 프로세스의 swap cluster에서 빈 슬롯 찾기
+	lock_acquire(&swap_lock);
+	swap_index = swap_alloc_slot(&page->spt->swap_cluster);
 	if (swap_index == BITMAP_ERROR)
 	{
-		return false; // swap disk가 가득 참
+		lock_release(&swap_lock);
+		// 모든 swap disk가 가득 참: 매핑을 되돌린다
+		pml4_set_page(page->pml4, page->va, page->frame->kva, page->writable);
+		return false;
 	}
+	sd = swap_slot_device(swap_index);
+	sd->out_cnt++;
+	lock_release(&swap_lock);
+
+	// 압축해서 메모리에 둘 수 있으면 disk에 쓰지 않는다
+	// 아니면 swap disk에 페이지 쓰기 (1 page = 8 sectors, 한 번의 명령으로)
+	if (!zswap_store(swap_index, page->frame->kva))
+		disk_write_multiple(sd->disk, (swap_index - sd->base) * SECTORS_PER_PAGE,
+							page->frame->kva, SECTORS_PER_PAGE);
+
+	// 인덱스 저장
+	anon_page->swap_index = swap_index;
+
+	return true;
+}
+
+/* One page write of anon_swap_out_batch(). */
+struct swap_write
+{
+	struct disk_request req;
+	size_t slot; /* Global swap slot. */
+};
 
-	// swap disk에 페이지 쓰기 (1 page = 8 sectors)
-	for (int i = 0; i < 8; i++)
+/* Swaps out the CNT resident anonymous pages in PAGES together.
+   Their writes are queued at once, so the disk queue issues them
+   in slot order and merges adjacent slots, which the per-process
+   clusters make common, into large transfers.  Moves the pages
+   that were swapped out to the front of PAGES and returns their
+   number; the others could not get a swap slot and are left as
+   they were.  Pages the compressed swap cache takes are not
+   written at all.
+   Every page is unmapped before it is compressed or written, so
+   a write to it meanwhile faults, and waits for the eviction in
+   vm_wait_evict(), instead of being lost. */
+size_t anon_swap_out_batch(struct page **pages, size_t cnt)
+{
+	struct swap_write *writes;
+	struct disk_request **reqs;
+	struct semaphore done;
+	size_t ok = 0, req_cnt = 0, i;
+
+	writes = malloc(cnt * sizeof *writes);
+	reqs = malloc(cnt * sizeof *reqs);
+	if (writes == NULL || reqs == NULL)
 	{
-		disk_write(swap_disk, swap_index * 8 + i, page->frame->kva + i * DISK_SECTOR_SIZE);
+		// 메모리가 없으면 한 페이지씩 내보낸다
+		free(writes);
+		free(reqs);
+		for (i = 0; i < cnt; i++)
+			if (anon_swap_out(pages[i]))
+			{
+				struct page *tmp = pages[ok];
+				pages[ok++] = pages[i];
+				pages[i] = tmp;
+			}
+		return ok;
 	}
 
-	// swap table에 표시하고 인덱스 저장
-	bitmap_set(swap_table, swap_index, true);
-	anon_page->swap_index = swap_index;
+	for (i = 0; i < cnt; i++)
+		pml4_clear_page(pages[i]->pml4, pages[i]->va);
 
-	// 페이지 테이블에서 매핑 제거
-	pml4_clear_page(page->pml4, page->va);
+	sema_init(&done, 0);
+	lock_acquire(&swap_lock);
+	for (i = 0; i < cnt; i++)
+	{
+		struct page *page = pages[i];
+		struct swap_write *w = &writes[ok];
+		struct swap_device *sd;
 
-	return true;
+		w->slot = swap_alloc_slot(&page->spt->swap_cluster);
+		if (w->slot == BITMAP_ERROR)
+			break; // 모든 swap disk가 가득 참
+		sd = swap_slot_device(w->slot);
+		sd->out_cnt++;
+		disk_request_init(&w->req, sd->disk, (w->slot - sd->base) * SECTORS_PER_PAGE,
+						  page->frame->kva, SECTORS_PER_PAGE, true, swap_io_done, &done);
+		pages[i] = pages[ok];
+		pages[ok++] = page;
+	}
+	lock_release(&swap_lock);
+
+	for (i = 0; i < ok; i++)
+		if (!zswap_store(writes[i].slot, pages[i]->frame->kva))
+			reqs[req_cnt++] = &writes[i].req;
+	disk_submit_many(reqs, req_cnt);
+	for (i = 0; i < req_cnt; i++)
+		sema_down(&done);
+
+	for (i = 0; i < ok; i++)
+		pages[i]->anon.swap_index = writes[i].slot;
+	// slot을 못 얻은 페이지는 매핑을 되돌린다
+	for (i = ok; i < cnt; i++)
+		pml4_set_page(pages[i]->pml4, pages[i]->va, pages[i]->frame->kva, pages[i]->writable);
+	free(writes);
+	free(reqs);
+	return ok;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
@@ -112,22 +841,18 @@ anon_destroy(struct page *page)
 {
 	struct anon_page *anon_page = &page->anon;
 
+	// evict 중이면 끝나기를 기다리고, 다시 evict되지 않게 한다
+	vm_destroy_begin(page);
 	// 페이지가 swap disk에 있으면 해당 슬롯 해제
 	if (anon_page->swap_index != -1)
 	{
-		bitmap_set(swap_table, anon_page->swap_index, false);
+		swap_put_slot(anon_page->swap_index, NULL);
 		anon_page->swap_index = -1;
 	}
 	if (page->frame == NULL)
 		return;
-	page->frame->ref_count--;
-	// 페이지가 메모리에 있으면 프레임 해제
-	if (page->frame->ref_count < 1)
-	{
-		pml4_clear_page(page->pml4, page->va);
-		list_remove(&page->frame->frame_elem);
-		palloc_free_page(page->frame->kva);
-		free(page->frame);
-		page->frame = NULL;
-	}
+	// 공유 중인 frame(COW, zero page)도 이 프로세스의 매핑은 제거
+	pml4_clear_page(page->pml4, page->va);
+	// 마지막 사용자면 프레임 해제
+	vm_put_frame(page);
 }
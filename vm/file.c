@@ -1,12 +1,67 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/inode.h"
+#include "threads/malloc.h"
 #include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
 #include "userprog/syscall.h"
 static bool file_backed_swap_in(struct page *page, void *kva);
 static bool file_backed_swap_out(struct page *page);
 static void file_backed_destroy(struct page *page);
 
+/* Fault-around: a fault on a page backed by file data, whether an
+ * executable segment or an mmap, also reads in the neighbours within
+ * an aligned window of fault_around_pages pages that are backed by
+ * the file data next to it, with one read, and maps them. */
+#define FAULT_AROUND_MAX 16
+size_t fault_around_pages = 8;	  /* -fault-around. */
+static long long fault_around_cnt; /* Faults that mapped neighbours. */
+static long long fault_around_page_cnt; /* Neighbours mapped. */
+
+/* Where a page that is not in memory gets its contents from. */
+struct file_source
+{
+	struct file *file;
+	off_t ofs;
+	size_t read_bytes;
+};
+static bool page_file_source(struct page *page, struct file_source *src);
+static bool file_source_follows(const struct file_source *a, const struct file_source *b);
+static bool fault_around_map(struct page *page, struct frame *frame);
+
+/* Sharing: read-only file-backed pages of a running program, such as
+ * its text, map one frame per (inode, offset, length) in every process.
+ * Each file_share lists the pages that map its frame, so that evicting
+ * the frame unmaps all of them at once and the next fault in any of
+ * them reads it in again.  Only inodes whose writes are denied take
+ * part, so a shared frame never goes stale: other files can change
+ * through write() or a writable mapping, and nothing would update
+ * their shared frames. */
+struct file_share
+{
+	struct hash_elem elem;
+	struct inode *inode; /* File data the frame holds. */
+	off_t ofs;
+	size_t read_bytes;
+	struct frame *frame;
+	struct list pages; /* Pages that map FRAME. */
+};
+static struct lock share_lock;		 /* Protects shares and each file_share. */
+static struct hash shares;			 /* file_share by inode, offset, length. */
+static long long share_hit_cnt;		 /* Faults served by a shared frame. */
+static long long share_evict_cnt;	 /* Shared frames evicted. */
+static bool file_share_evict(struct page *page);
+static void file_share_leave(struct page *page);
+static uint64_t share_hash(const struct hash_elem *e, void *aux);
+static bool share_less(const struct hash_elem *a, const struct hash_elem *b, void *aux);
+
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
 	.swap_in = file_backed_swap_in,
@@ -18,6 +73,8 @@ static const struct page_operations file_ops = {
 /* The initializer of file vm */
 void vm_file_init(void)
 {
+	lock_init(&share_lock);
+	hash_init(&shares, share_hash, share_less, NULL);
 }
 
 /* Initialize the file backed page */
@@ -27,40 +84,431 @@ bool file_backed_initializer(struct page *page, enum vm_type type, void *kva)
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	file_page->file = NULL;
+	file_page->ref = NULL;
+	file_page->share = NULL;
 	return true;
 }
 
+/* Opens a new handle for FILE, to be shared through references.
+ * Returns NULL if out of memory. */
+struct file_ref *
+file_ref_open(struct file *file)
+{
+	bool need_lock = !lock_held_by_current_thread(&filesys_lock);
+	struct file_ref *ref = malloc(sizeof *ref);
+
+	if (ref == NULL)
+		return NULL;
+	if (need_lock)
+		lock_acquire(&filesys_lock);
+	ref->file = file_reopen(file);
+	ref->refs = 1;
+	if (need_lock)
+		lock_release(&filesys_lock);
+	if (ref->file == NULL)
+	{
+		free(ref);
+		return NULL;
+	}
+	return ref;
+}
+
+/* Takes another reference to REF and returns it. */
+struct file_ref *
+file_ref_get(struct file_ref *ref)
+{
+	bool need_lock = !lock_held_by_current_thread(&filesys_lock);
+
+	if (need_lock)
+		lock_acquire(&filesys_lock);
+	ref->refs++;
+	if (need_lock)
+		lock_release(&filesys_lock);
+	return ref;
+}
+
+/* Drops a reference to REF, closing the file with the last one. */
+void file_ref_put(struct file_ref *ref)
+{
+	bool need_lock = !lock_held_by_current_thread(&filesys_lock);
+	bool last;
+
+	if (need_lock)
+		lock_acquire(&filesys_lock);
+	last = --ref->refs == 0;
+	if (last)
+		file_close(ref->file);
+	if (need_lock)
+		lock_release(&filesys_lock);
+	if (last)
+		free(ref);
+}
+
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in(struct page *page, void *kva)
 {
 	struct file_page *file_page = &page->file;
+	bool ok;
 
-	// 파일에서 페이지 데이터 읽기
+	// 파일에서 페이지 데이터 읽기 (이웃 페이지도 함께)
 	lock_acquire(&filesys_lock);
-	file_seek(file_page->file, file_page->offset);
-	int bytes_read = file_read(file_page->file, kva, file_page->page_read_bytes);
+	ok = file_read_around(page, file_page->file, file_page->offset,
+						  file_page->page_read_bytes, kva);
 	lock_release(&filesys_lock);
+	return ok;
+}
+
+/* Reads the READ_BYTES bytes at offset OFS in FILE that back PAGE
+ * into KVA and zeros the rest of the page.  Neighbours of PAGE that
+ * are not in memory and are backed by the file data right before or
+ * after it are read with the same file_read_at() and mapped, as long
+ * as frames are free without evicting.  A region advised with
+ * MADV_RANDOM reads no neighbours, and one advised with
+ * MADV_SEQUENTIAL reads as many as it can, after PAGE only.
+ * filesys_lock must be held. */
+bool file_read_around(struct page *page, struct file *file, off_t ofs,
+					  size_t read_bytes, void *kva)
+{
+	struct frame *frames[FAULT_AROUND_MAX];
+	struct file_source src = {file, ofs, read_bytes}, lo_src, hi_src, s;
+	size_t window, cnt, last_bytes, mapped = 0, i;
+	uint8_t *base, *lo, *hi, *va, *buf = NULL;
+	enum vma_advice advice;
+	off_t bytes_read;
+
+	// window 안에서 파일 데이터가 이어지는 이웃 페이지를 찾는다
+	window = fault_around_pages < FAULT_AROUND_MAX ? fault_around_pages : FAULT_AROUND_MAX;
+	advice = vma_advice_at(page->spt, page->va);
+	if (advice == VMA_ADV_RANDOM)
+		window = 1;
+	else if (advice == VMA_ADV_SEQUENTIAL)
+		window = FAULT_AROUND_MAX;
+	lo = hi = page->va;
+	lo_src = hi_src = src;
+	if (window > 1)
+	{
+		// 순차 접근이면 뒤쪽으로만 넓게 읽는다
+		if (advice == VMA_ADV_SEQUENTIAL)
+			base = page->va;
+		else
+			base = (uint8_t *)page->va - pg_no(page->va) % window * PGSIZE;
+		while (lo > base && page_file_source(spt_find_page(page->spt, lo - PGSIZE), &s) && file_source_follows(&s, &lo_src))
+		{
+			lo -= PGSIZE;
+			lo_src = s;
+		}
+		while (hi + PGSIZE < base + window * PGSIZE && page_file_source(spt_find_page(page->spt, hi + PGSIZE), &s) && file_source_follows(&hi_src, &s))
+		{
+			hi += PGSIZE;
+			hi_src = s;
+		}
+	}
+	last_bytes = hi_src.read_bytes;
+
+	// 이웃 페이지의 frame은 evict 없이 얻을 수 있을 때만 사용
+	for (va = (uint8_t *)page->va + PGSIZE; va <= hi; va += PGSIZE)
+		if ((frames[(va - lo) / PGSIZE] = vm_try_get_frame()) == NULL)
+		{
+			hi = va - PGSIZE;
+			last_bytes = PGSIZE;
+			break;
+		}
+	for (va = (uint8_t *)page->va - PGSIZE; va >= lo; va -= PGSIZE)
+		if ((frames[(va - lo) / PGSIZE] = vm_try_get_frame()) == NULL)
+			break;
+	if (va >= lo)
+	{
+		// 앞쪽에서 frame이 모자라면 거기까지만 읽는다
+		size_t skip = (va - lo) / PGSIZE + 1;
+		for (i = 0; i < (size_t)(hi - va) / PGSIZE; i++)
+			frames[i] = frames[i + skip];
+		lo = va + PGSIZE;
+	}
+	if (hi == page->va)
+		last_bytes = read_bytes;
+
+	cnt = (hi - lo) / PGSIZE + 1;
+	if (cnt > 1 && (buf = palloc_get_multiple(0, cnt)) == NULL)
+	{
+		for (va = lo; va <= hi; va += PGSIZE)
+			if (va != page->va)
+				vm_free_frame(frames[(va - lo) / PGSIZE]);
+		lo = hi = page->va;
+		last_bytes = read_bytes;
+		cnt = 1;
+	}
 
-	// 파일이 비어있거나 짧은 경우, 읽은 만큼만 사용하고 나머지는 0으로 채움
-	if (bytes_read < (int)file_page->page_read_bytes)
+	if (cnt == 1)
 	{
+		bytes_read = file_read_at(file, kva, read_bytes, ofs);
 		memset(kva + bytes_read, 0, PGSIZE - bytes_read);
+		return true;
+	}
+
+	// 한 번의 read로 모두 읽고 각 frame에 나눠 담는다
+	bytes_read = file_read_at(file, buf, (hi - lo) + last_bytes,
+							  ofs - ((uint8_t *)page->va - lo));
+	for (va = lo, i = 0; va <= hi; va += PGSIZE, i++)
+	{
+		uint8_t *dst = va == page->va ? kva : frames[i]->kva;
+		size_t valid = bytes_read > (off_t)(i * PGSIZE) ? bytes_read - i * PGSIZE : 0;
+		size_t page_bytes = va == hi ? last_bytes : PGSIZE;
+
+		if (valid > page_bytes)
+			valid = page_bytes;
+		memcpy(dst, buf + i * PGSIZE, valid);
+		memset(dst + valid, 0, PGSIZE - valid);
 	}
-	else
+	palloc_free_multiple(buf, cnt);
+
+	for (va = lo, i = 0; va <= hi; va += PGSIZE, i++)
+		if (va != page->va)
+			mapped += fault_around_map(spt_find_page(page->spt, va), frames[i]);
+	if (mapped > 0)
 	{
-		// 나머지 부분은 0으로 채움
-		memset(kva + file_page->page_read_bytes, 0, PGSIZE - file_page->page_read_bytes);
+		fault_around_cnt++;
+		fault_around_page_cnt += mapped;
 	}
 	return true;
 }
 
+/* If PAGE is not in memory and gets its contents from a file,
+ * either through lazy loading or as a file-backed page that was
+ * evicted, stores where in *SRC and returns true. */
+static bool
+page_file_source(struct page *page, struct file_source *src)
+{
+	if (page == NULL || page->frame != NULL)
+		return false;
+	if (page->operations->type == VM_UNINIT && page->uninit.init == (vm_initializer *)lazy_load_segment && page->uninit.aux != NULL)
+	{
+		struct new_aux *aux = page->uninit.aux;
+		*src = (struct file_source){aux->file, aux->offset, aux->page_read_bytes};
+		return true;
+	}
+	if (VM_TYPE(page->operations->type) == VM_FILE && page->file.file != NULL)
+	{
+		*src = (struct file_source){page->file.file, page->file.offset, page->file.page_read_bytes};
+		return true;
+	}
+	return false;
+}
+
+/* Returns true if B's data starts in the same file right where A's,
+ * a full page, ends. */
+static bool
+file_source_follows(const struct file_source *a, const struct file_source *b)
+{
+	return a->read_bytes == PGSIZE && b->ofs == a->ofs + PGSIZE && file_get_inode(a->file) == file_get_inode(b->file);
+}
+
+/* Maps PAGE, a neighbour read in by file_read_around(), to FRAME,
+ * which holds its contents, and finishes loading it.  Frees FRAME
+ * and returns false if it cannot be mapped. */
+static bool
+fault_around_map(struct page *page, struct frame *frame)
+{
+	// 다른 프로세스가 이미 올려 둔 페이지면 읽은 내용 대신 그 frame을 공유
+	if (file_share_map(page))
+	{
+		vm_free_frame(frame);
+		return true;
+	}
+	if (!pml4_set_page(page->pml4, page->va, frame->kva, page->writable))
+	{
+		vm_free_frame(frame);
+		return false;
+	}
+	if (page->operations->type == VM_UNINIT)
+	{
+		struct new_aux *aux = page->uninit.aux;
+		page->uninit.page_initializer(page, page->uninit.type, frame->kva);
+		lazy_load_finish(page, aux);
+	}
+	// 내용이 다 찬 뒤에 연결해야 evict 대상이 된다
+	page->frame = frame;
+	frame->page = page;
+	file_share_add(page);
+	return true;
+}
+
+/* Prints fault-around statistics. */
+void file_print_stats(void)
+{
+	if (fault_around_pages > 1)
+		printf("Fault-around: %lld faults read in %lld neighbouring pages\n",
+			   fault_around_cnt, fault_around_page_cnt);
+	printf("Shared file pages: %zu frames, %lld faults served, %lld evicted\n",
+		   hash_size(&shares), share_hit_cnt, share_evict_cnt);
+}
+
+/* If PAGE is a read-only file-backed page that is not in memory and
+ * another page already holds its contents in a shared frame, maps
+ * PAGE to that frame and returns true.  Otherwise returns false. */
+bool file_share_map(struct page *page)
+{
+	enum vm_type type = page->operations->type == VM_UNINIT ? page->uninit.type : page->operations->type;
+	struct file_source src;
+	struct file_share key, *share = NULL;
+	struct new_aux *aux = NULL;
+	struct hash_elem *e;
+
+	if (page->writable || VM_TYPE(type) != VM_FILE || !page_file_source(page, &src))
+		return false;
+	// 실행 중이라 쓰기가 막힌 파일만 공유한다
+	if (!inode_is_write_denied(file_get_inode(src.file)))
+		return false;
+	key.inode = file_get_inode(src.file);
+	key.ofs = src.ofs;
+	key.read_bytes = src.read_bytes;
+
+	lock_acquire(&share_lock);
+	e = hash_find(&shares, &key.elem);
+	if (e != NULL && pml4_set_page(page->pml4, page->va, hash_entry(e, struct file_share, elem)->frame->kva, false))
+	{
+		share = hash_entry(e, struct file_share, elem);
+		if (page->operations->type == VM_UNINIT)
+		{
+			// lazy loading을 읽기 없이 끝낸다 (aux 정리는 lock 밖에서)
+			aux = page->uninit.aux;
+			page->uninit.page_initializer(page, page->uninit.type, share->frame->kva);
+		}
+		vm_share_frame(page, share->frame);
+		page->file.share = share;
+		list_push_back(&share->pages, &page->file.share_elem);
+		share_hit_cnt++;
+	}
+	lock_release(&share_lock);
+	// filesys_lock을 share_lock 안에서 잡지 않는다
+	if (aux != NULL)
+		lazy_load_finish(page, aux);
+	return share != NULL;
+}
+
+/* Offers the frame of PAGE, a read-only file-backed page that was
+ * just read in, to other pages with the same contents. */
+void file_share_add(struct page *page)
+{
+	struct file_share *share;
+
+	if (page->writable || VM_TYPE(page->operations->type) != VM_FILE || page->frame == NULL || page->file.share != NULL)
+		return;
+	if (!inode_is_write_denied(file_get_inode(page->file.file)))
+		return;
+	share = malloc(sizeof *share);
+	if (share == NULL)
+		return;
+	share->inode = file_get_inode(page->file.file);
+	share->ofs = page->file.offset;
+	share->read_bytes = page->file.page_read_bytes;
+	share->frame = page->frame;
+	list_init(&share->pages);
+
+	lock_acquire(&share_lock);
+	// 다른 프로세스가 먼저 올렸으면 이 frame은 그냥 private으로 둔다
+	if (hash_insert(&shares, &share->elem) == NULL)
+	{
+		list_push_back(&share->pages, &page->file.share_elem);
+		page->file.share = share;
+		share->frame->share = share;
+		share = NULL;
+	}
+	lock_release(&share_lock);
+	free(share);
+}
+
+/* If PAGE maps a shared frame, which is being evicted, unmaps the
+ * frame from every page that maps it and returns true. */
+static bool
+file_share_evict(struct page *page)
+{
+	struct file_share *share;
+	bool shared;
+
+	lock_acquire(&share_lock);
+	share = page->file.share;
+	shared = share != NULL;
+	if (shared)
+	{
+		while (!list_empty(&share->pages))
+		{
+			struct page *p = list_entry(list_pop_front(&share->pages), struct page, file.share_elem);
+			pml4_clear_page(p->pml4, p->va);
+			// evict 중인 페이지의 frame은 evictor가 끊는다
+			if (p != page)
+				p->frame = NULL;
+			p->file.share = NULL;
+		}
+		hash_delete(&shares, &share->elem);
+		// 모든 참조가 사라졌으므로 victim frame은 한 페이지 것으로 돌아간다
+		share->frame->share = NULL;
+		share->frame->ref_count = 1;
+		share_evict_cnt++;
+	}
+	lock_release(&share_lock);
+	free(share);
+	return shared;
+}
+
+/* Takes PAGE, which is being destroyed, off its shared frame's list
+ * of pages.  The caller still drops PAGE's reference to the frame. */
+static void
+file_share_leave(struct page *page)
+{
+	struct file_share *share, *dead = NULL;
+
+	lock_acquire(&share_lock);
+	share = page->file.share;
+	if (share != NULL)
+	{
+		list_remove(&page->file.share_elem);
+		page->file.share = NULL;
+		if (list_empty(&share->pages))
+		{
+			hash_delete(&shares, &share->elem);
+			share->frame->share = NULL;
+			dead = share;
+		}
+		else if (share->frame->page == page || share->frame->page == NULL)
+			// evict할 때 쓸 대표 페이지를 남은 페이지로 바꾼다
+			share->frame->page = list_entry(list_front(&share->pages), struct page, file.share_elem);
+	}
+	lock_release(&share_lock);
+	free(dead);
+}
+
+static uint64_t
+share_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	const struct file_share *s = hash_entry(e, struct file_share, elem);
+	return hash_bytes(&s->inode, sizeof s->inode) ^ hash_int(s->ofs);
+}
+
+static bool
+share_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED)
+{
+	const struct file_share *a = hash_entry(a_, struct file_share, elem);
+	const struct file_share *b = hash_entry(b_, struct file_share, elem);
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	if (a->ofs != b->ofs)
+		return a->ofs < b->ofs;
+	return a->read_bytes < b->read_bytes;
+}
+
 /* Swap out the page by writeback contents to the file. */
 static bool
 file_backed_swap_out(struct page *page)
 {
 	struct file_page *file_page = &page->file;
 
+	// 공유 frame이면 매핑한 모든 페이지에서 한 번에 내린다
+	if (file_share_evict(page))
+		return true;
+
 	// Dirty bit 확인
 	if (pml4_is_dirty(page->pml4, page->va))
 	{
@@ -71,9 +519,8 @@ file_backed_swap_out(struct page *page)
 		lock_release(&filesys_lock);
 	}
 
-	// 페이지 테이블 엔트리 제거
+	// 페이지 테이블 엔트리 제거 (page->frame은 evictor가 끊는다)
 	pml4_clear_page(page->pml4, page->va);
-	page->frame = NULL;
 	return true;
 }
 
@@ -83,6 +530,8 @@ file_backed_destroy(struct page *page)
 {
 	struct file_page *file_page = &page->file;
 
+	// evict 중이면 끝나기를 기다리고, 다시 evict되지 않게 한다
+	vm_destroy_begin(page);
 	// 페이지가 메모리에 로드되어 있으면 write-back
 	if (page->frame != NULL && page->writable)
 	{
@@ -94,18 +543,16 @@ file_backed_destroy(struct page *page)
 			lock_release(&filesys_lock);
 		}
 	}
-	if (page->frame == NULL)
-		return;
-	page->frame->ref_count--;
-	// 파일 핸들 닫기 (메모리에 있든 없든 항상 닫아야 함)
-	if (file_page->file != NULL && page->frame->ref_count < 1)
+	if (page->frame != NULL)
 	{
-		lock_acquire(&filesys_lock);
-		file_close(file_page->file);
-		list_remove(&page->frame->frame_elem);
-		palloc_free_page(page->frame->kva);
-		lock_release(&filesys_lock);
-		free(page->frame);
+		file_share_leave(page);
+		vm_put_frame(page);
+	}
+	// region과 함께 쓰는 파일 참조를 내려놓는다 (마지막이면 닫힌다)
+	if (file_page->ref != NULL)
+	{
+		file_ref_put(file_page->ref);
+		file_page->ref = NULL;
 		file_page->file = NULL;
 	}
 }
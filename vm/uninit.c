@@ -8,10 +8,12 @@
  * function.
  * */
 
+#include <string.h>
 #include "vm/vm.h"
 #include "vm/uninit.h"
 #include "userprog/process.h"
 #include "userprog/syscall.h"
+#include "threads/vaddr.h"
 
 static bool uninit_initialize(struct page *page, void *kva);
 static void uninit_destroy(struct page *page);
@@ -54,8 +56,14 @@ uninit_initialize(struct page *page, void *kva)
 	void *aux = uninit->aux;
 
 	/* TODO: You may need to fix this function. */
-	return uninit->page_initializer(page, uninit->type, kva) &&
-		   (init ? init(page, aux) : true);
+	if (!uninit->page_initializer(page, uninit->type, kva))
+		return false;
+	if (init != NULL)
+		return init(page, aux);
+	// initializer가 없는 페이지는 0으로 시작 (frame은 재사용된 것일 수 있다)
+	if (!page->frame->zeroed)
+		memset(kva, 0, PGSIZE);
+	return true;
 }
 
 /* Free the resources hold by uninit_page. Although most of pages are transmuted
@@ -69,17 +77,7 @@ uninit_destroy(struct page *page)
 	/* TODO: Fill this function.
 	 * TODO: If you don't have anything to do, just return. */
 	struct new_aux *aux = (struct new_aux *)uninit->aux;
+	// fork로 공유된 aux일 수 있으므로 참조만 내려놓는다
 	if (aux)
-	{
-		if (aux->file != NULL)
-		{
-			bool need_lock = !lock_held_by_current_thread(&filesys_lock);
-			if (need_lock)
-				lock_acquire(&filesys_lock);
-			file_close(aux->file);
-			if (need_lock)
-				lock_release(&filesys_lock);
-		}
-		free(aux);
-	}
+		lazy_aux_put(aux);
 }
@@ -5,6 +5,7 @@
 #include "threads/vaddr.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "vm/zswap.h"
 #include "hash.h"
 #include "threads/mmu.h"
 #include "devices/timer.h"
@@ -14,6 +15,109 @@
 #include "userprog/process.h"
 #include "filesys/file.h"
 static struct list frame_table;
+static struct lock frame_lock;		 /* Protects frame_table, clock_hand, ages. */
+static size_t frame_cnt;			 /* Number of frames in frame_table. */
+static struct list_elem *clock_hand; /* Next frame the clock looks at. */
+static struct list free_frames;		 /* Evicted frames ready for reuse. */
+static struct condition evict_done;	 /* A frame's eviction finished. */
+static struct frame zero_frame;		 /* Shared, read-only page of zeros. */
+
+/* Pre-zeroed frames, filled by the low priority vm_zero thread so
+ * that zero-fill faults need not clear a page themselves. */
+#define VM_ZERO_POOL_MAX 32
+static struct list zero_pool;		  /* Protected by frame_lock. */
+static size_t zero_pool_cnt;		  /* Number of frames in zero_pool. */
+static bool zero_pool_refilling;	  /* vm_zero is awake. Protected by frame_lock. */
+static struct semaphore zero_pool_wake;
+static long long zero_pool_hit_cnt;	  /* Zero-fill faults served from the pool. */
+static long long zero_pool_miss_cnt;  /* ...that found it empty. */
+static void vm_zero_thread(void *aux UNUSED);
+static size_t free_frame_cnt;		 /* Number of frames in free_frames. */
+
+/* Number of victims one eviction pass reclaims. */
+#define VM_EVICT_BATCH 16
+
+/* Background reclaim: kswapd is woken when free user frames drop
+ * below vm_wmark_low and evicts until vm_wmark_high are free.
+ * Zero means a default based on the size of the user pool. */
+size_t vm_wmark_low;  /* -wmark-low. */
+size_t vm_wmark_high; /* -wmark-high. */
+static struct semaphore kswapd_wake;
+static bool kswapd_running;		   /* Woken and not yet done. Protected by frame_lock. */
+static long long kswapd_wake_cnt;  /* Times kswapd was woken. */
+static long long kswapd_evict_cnt; /* Frames kswapd freed. */
+static long long direct_evict_cnt; /* Frames freed by faulting threads. */
+static void vm_kswapd(void *aux UNUSED);
+static size_t vm_free_frames(void);
+
+/* Aging: every VM_AGING_INTERVAL ticks the accessed bit of each
+ * resident page is shifted into the top of its frame's age. */
+#define VM_AGING_INTERVAL 10
+#define VM_AGE_RECENT 0x80
+static void vm_aging_thread(void *aux UNUSED);
+
+/* Same-page merging: every VM_KSM_INTERVAL ticks ksmd checksums the
+ * next vm_ksm_pages frames of the frame table and merges anonymous
+ * pages with identical contents into one read-only frame, shared
+ * through the COW machinery until one of them is written. */
+#define VM_KSM_INTERVAL (TIMER_FREQ / 10)
+size_t vm_ksm_pages;				 /* -ksm. */
+static struct hash ksm_table;		 /* Candidate frames by checksum. Protected by frame_lock. */
+static struct list_elem *ksm_cursor; /* Next frame ksmd looks at. */
+static uint64_t ksm_zero_sum;		 /* Checksum of a page of zeros. */
+static long long ksm_scan_cnt;		 /* Frames looked at. */
+static long long ksm_merge_cnt;		 /* Pages merged into another frame. */
+static long long ksm_zero_merge_cnt; /* ...of which into the zero frame. */
+static long long ksm_unmerge_cnt;	 /* Writes that split a merged frame. */
+static void vm_ksmd(void *aux UNUSED);
+static uint64_t ksm_hash(const struct hash_elem *e, void *aux);
+static bool ksm_less(const struct hash_elem *a, const struct hash_elem *b, void *aux);
+
+/* mlock(): locked pages keep their frames, which are never picked
+ * for eviction and never merged.  A frame counts the locked pages
+ * that map it, and a process the pages it has locked. */
+size_t vm_mlock_limit;			/* -mlock-limit. */
+static size_t mlock_cnt;		/* Pages locked now. Protected by frame_lock. */
+static size_t mlock_peak;		/* Most pages ever locked at once. */
+static long long mlock_refuse_cnt; /* mlock() calls over the limit. */
+static bool vm_lock_page(struct page *page);
+static void page_unlock(struct page *page);
+
+/* Writeback: every vm_flush_interval ms the flusher thread writes
+ * back up to VM_FLUSH_BATCH dirty pages of writable file mappings,
+ * going round the frame table from where it last stopped.  Their
+ * data thus reaches the disk a little at a time instead of all at
+ * eviction or exit, and evicting them later needs no write. */
+#define VM_FLUSH_BATCH 32
+unsigned vm_flush_interval = 1000;	   /* -flush-interval, 0 if off. */
+static struct list_elem *flush_cursor; /* Next frame the flusher looks at. */
+static long long flush_cnt;			   /* Pages written by the flusher. */
+static long long sync_cnt;			   /* ...and by msync(). */
+static void vm_flusher(void *aux UNUSED);
+
+/* Large pages: the first write to a 2 MB aligned, still untouched
+ * stretch of an anonymous region maps all of it with one 2 MB page.
+ * Each 4 kB page keeps its own struct page and struct frame, so the
+ * rest of the VM works on them as usual; the page table entry is
+ * split into 4 kB ones as soon as one of them is remapped or unmapped,
+ * as COW, eviction and munmap do. */
+bool vm_large_pages;				/* -large-pages. */
+static long long large_map_cnt;		/* 2 MB pages mapped. */
+static long long large_fail_cnt;	/* ...not mapped for want of aligned memory. */
+static bool vm_map_large(struct page *page);
+
+/* madvise(): MADV_SEQUENTIAL regions have the pages from
+ * VM_DROP_BEHIND to 2 * VM_DROP_BEHIND pages behind each fault made
+ * the first to be evicted. */
+#define VM_DROP_BEHIND 16
+static long long prefetch_cnt;	  /* Pages read in for MADV_WILLNEED. */
+static long long discard_cnt;	  /* Pages dropped for MADV_DONTNEED. */
+static long long drop_behind_cnt; /* Pages aged behind sequential faults. */
+static void vm_drop_behind(struct page *page);
+
+/* -evict: page replacement policy. */
+enum vm_evict_policy vm_evict_policy = VM_EVICT_LRU;
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void vm_init(void)
@@ -27,6 +131,85 @@ void vm_init(void)
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */;
 	list_init(&frame_table);
+	lock_init(&frame_lock);
+	cond_init(&evict_done);
+	frame_cnt = 0;
+	clock_hand = list_end(&frame_table);
+	list_init(&free_frames);
+	free_frame_cnt = 0;
+
+	/* The zero frame lives in the kernel pool, outside the frame
+	 * table, so it is never evicted.  Its own reference keeps
+	 * ref_count above 1 while any page maps it, which makes every
+	 * write to it go through the COW path. */
+	zero_frame.kva = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+	zero_frame.page = NULL;
+	zero_frame.ref_count = 1;
+	zero_frame.age = 0;
+	zero_frame.zeroed = true;
+	thread_create("vm_aging", PRI_DEFAULT, vm_aging_thread, NULL);
+
+	size_t user_pages = palloc_user_page_cnt();
+	if (vm_wmark_low == 0)
+		vm_wmark_low = user_pages / 32 > 4 ? user_pages / 32 : 4;
+	if (vm_wmark_high <= vm_wmark_low)
+		vm_wmark_high = vm_wmark_low * 2;
+	// 워터마크가 user pool의 절반을 넘지 않도록
+	if (vm_wmark_high > user_pages / 2)
+		vm_wmark_high = user_pages / 2;
+	if (vm_wmark_low > vm_wmark_high)
+		vm_wmark_low = vm_wmark_high;
+	if (vm_mlock_limit == 0)
+		vm_mlock_limit = user_pages / 8;
+	sema_init(&kswapd_wake, 0);
+	thread_create("kswapd", PRI_DEFAULT, vm_kswapd, NULL);
+
+	list_init(&zero_pool);
+	zero_pool_cnt = 0;
+	zero_pool_refilling = true;
+	sema_init(&zero_pool_wake, 1);
+	thread_create("vm_zero", PRI_MIN, vm_zero_thread, NULL);
+
+	hash_init(&ksm_table, ksm_hash, ksm_less, NULL);
+	ksm_cursor = list_end(&frame_table);
+	ksm_zero_sum = hash_bytes(zero_frame.kva, PGSIZE);
+	if (vm_ksm_pages > 0)
+		thread_create("ksmd", PRI_DEFAULT, vm_ksmd, NULL);
+
+	flush_cursor = list_end(&frame_table);
+	if (vm_flush_interval > 0)
+		thread_create("flusher", PRI_DEFAULT, vm_flusher, NULL);
+}
+
+/* Prints virtual memory statistics. */
+void vm_print_stats(void)
+{
+	printf("kswapd: watermarks %zu/%zu pages, %lld wakeups, %lld frames freed; "
+		   "%lld frames freed directly\n",
+		   vm_wmark_low, vm_wmark_high, kswapd_wake_cnt, kswapd_evict_cnt,
+		   direct_evict_cnt);
+	printf("Zeroed frame pool: %lld hits, %lld misses\n",
+		   zero_pool_hit_cnt, zero_pool_miss_cnt);
+	if (vm_ksm_pages > 0)
+		printf("KSM: %lld frames scanned, %lld pages merged (%lld into the zero page), "
+			   "%lld unmerged\n",
+			   ksm_scan_cnt, ksm_merge_cnt, ksm_zero_merge_cnt, ksm_unmerge_cnt);
+	if (vm_large_pages)
+		printf("Large pages: %lld mapped, %lld without aligned memory\n",
+			   large_map_cnt, large_fail_cnt);
+	if (flush_cnt > 0 || sync_cnt > 0)
+		printf("Writeback: %lld pages by the flusher, %lld by msync\n",
+			   flush_cnt, sync_cnt);
+	if (mlock_peak > 0 || mlock_refuse_cnt > 0)
+		printf("mlock: %zu pages locked (peak %zu), limit %zu per process, "
+			   "%lld requests refused\n",
+			   mlock_cnt, mlock_peak, vm_mlock_limit, mlock_refuse_cnt);
+	if (prefetch_cnt > 0 || discard_cnt > 0 || drop_behind_cnt > 0)
+		printf("madvise: %lld pages prefetched, %lld discarded, %lld dropped behind\n",
+			   prefetch_cnt, discard_cnt, drop_behind_cnt);
+	file_print_stats();
+	swap_print_stats();
+	zswap_print_stats();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -49,6 +232,12 @@ page_get_type(struct page *page)
 static struct frame *vm_get_victim(void);
 static bool vm_do_claim_page(struct page *page);
 static struct frame *vm_evict_frame(void);
+static size_t vm_evict_batch(void);
+static bool vm_map_zero_page(struct page *page);
+static bool page_is_zero_fill(struct page *page);
+static struct frame *vm_get_zeroed_frame(void);
+static struct frame *zero_pool_take(void);
+static void frame_table_add(struct frame *frame, bool zeroed);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -62,7 +251,7 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writabl
 	struct supplemental_page_table *spt = &thread_current()->spt;
 
 	/* Check wheter the upage is already occupied or not. */
-	if (spt_find_page(spt, upage) == NULL)
+	if (spt_peek_page(spt, upage) == NULL)
 	{
 		/* TODO: Create the page, fetch the initialier according to the VM type,
 		 * TODO: and then create "uninit" page struct by calling uninit_new. You
@@ -87,8 +276,9 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writabl
 		}
 		uninit_new(new_page, upage, init, type, aux, page_initializer);
 		new_page->writable = writable;
-		new_page->last_used_tick = timer_ticks();
+		new_page->locked = false;
 		new_page->pml4 = thread_current()->pml4;
+		new_page->spt = spt;
 		/* TODO: Insert the page into the spt. */
 		if (!spt_insert_page(spt, new_page))
 		{
@@ -113,13 +303,26 @@ spt_find_page(struct supplemental_page_table *spt, void *va)
 	struct hash_elem *e = hash_find(&spt->spt_hash, &temp.hash_elem);
 	if (e == NULL)
 	{
-		return NULL;
+		// 아직 만들지 않은 페이지: 속한 region이 있으면 지금 만든다
+		return spt == &thread_current()->spt ? vma_page_in(spt, temp.va) : NULL;
 	}
 	page = hash_entry(e, struct page, hash_elem);
-	page->last_used_tick = timer_ticks();
 	return page;
 }
 
+/* Like spt_find_page(), but only finds pages that exist already and
+ * never creates one for a region. */
+struct page *
+spt_peek_page(struct supplemental_page_table *spt, void *va)
+{
+	struct page temp;
+	struct hash_elem *e;
+
+	temp.va = pg_round_down(va);
+	e = hash_find(&spt->spt_hash, &temp.hash_elem);
+	return e != NULL ? hash_entry(e, struct page, hash_elem) : NULL;
+}
+
 /* Insert PAGE into spt with validation. */
 bool spt_insert_page(struct supplemental_page_table *spt, struct page *page)
 {
@@ -136,57 +339,262 @@ void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
 	// return true; // void인데 왜 리턴?
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Returns true if FRAME can be handed to another page.
+ * Frames shared by COW are never evicted; shared read-only file
+ * pages are, and their swap_out() unmaps every page.  Frames of
+ * locked pages are never evicted. */
+static bool
+frame_is_evictable(struct frame *f)
+{
+	return f->page != NULL && f->lock_cnt == 0 && (f->ref_count == 1 || f->share != NULL);
+}
+
+/* Returns FRAME's age, counting a reference made since the last
+ * aging pass as the most recent one. */
+static uint8_t
+frame_age(struct frame *f)
+{
+	uint8_t age = f->age;
+	if (pml4_is_accessed(f->page->pml4, f->page->va))
+		age |= VM_AGE_RECENT;
+	return age;
+}
+
+/* LRU (aging approximation): find the frame with the smallest age. */
 static struct frame *
-vm_get_victim(void)
+lru_get_victim(void)
 {
 	struct frame *victim = NULL;
-	/* TODO: The policy for eviction is up to you. */
+	struct list_elem *e;
+	int min_age = VM_AGE_RECENT << 1;
 
-	if (!list_empty(&frame_table))
+	for (e = list_begin(&frame_table); e != list_end(&frame_table); e = list_next(e))
 	{
-		// LRU: find frame with minimum last_used_tick that has a page
-		struct list_elem *e;
-		uint64_t min_tick = UINT64_MAX;
-		for (e = list_begin(&frame_table); e != list_end(&frame_table); e = list_next(e))
+		struct frame *f = list_entry(e, struct frame, frame_elem);
+		if (frame_is_evictable(f))
 		{
-			struct frame *f = list_entry(e, struct frame, frame_elem);
-			if (f->page != NULL && f->ref_count == 1)
+			int age = frame_age(f);
+			if (age < min_age)
 			{
-				uint64_t tick = f->page->last_used_tick;
-				if (tick < min_tick)
-				{
-					min_tick = tick;
-					victim = f;
-				}
+				min_age = age;
+				victim = f;
+				if (age == 0)
+					break;
 			}
 		}
 	}
 	return victim;
 }
 
-/* Evict one page and return the corresponding frame.
+/* Clock (second chance): advance the hand over the frame table,
+ * clearing the accessed bit of every recently used page, and
+ * pick the first page whose accessed bit is already clear.
+ * Two full revolutions are enough to find a victim if one exists. */
+static struct frame *
+clock_get_victim(void)
+{
+	size_t budget = frame_cnt * 2 + 1;
+
+	while (budget-- > 0)
+	{
+		if (clock_hand == list_end(&frame_table))
+			clock_hand = list_begin(&frame_table);
+		if (clock_hand == list_end(&frame_table))
+			break;
+
+		struct frame *f = list_entry(clock_hand, struct frame, frame_elem);
+		clock_hand = list_next(clock_hand);
+		if (!frame_is_evictable(f))
+			continue;
+
+		struct page *page = f->page;
+		if (pml4_is_accessed(page->pml4, page->va) || (f->age & VM_AGE_RECENT))
+		{
+			pml4_set_accessed(page->pml4, page->va, false);
+			f->age &= ~VM_AGE_RECENT;
+			continue;
+		}
+		return f;
+	}
+	return NULL;
+}
+
+/* Get the struct frame, that will be evicted.
+ * Must be called with frame_lock held. */
+static struct frame *
+vm_get_victim(void)
+{
+	/* TODO: The policy for eviction is up to you. */
+	switch (vm_evict_policy)
+	{
+	case VM_EVICT_CLOCK:
+		return clock_get_victim();
+	case VM_EVICT_LRU:
+	default:
+		return lru_get_victim();
+	}
+}
+
+/* Removes F from the frame table. frame_lock must be held. */
+static void
+frame_table_remove(struct frame *f)
+{
+	if (clock_hand == &f->frame_elem)
+		clock_hand = list_next(clock_hand);
+	if (ksm_cursor == &f->frame_elem)
+		ksm_cursor = list_next(ksm_cursor);
+	if (flush_cursor == &f->frame_elem)
+		flush_cursor = list_next(flush_cursor);
+	if (f->ksm_listed)
+	{
+		hash_delete(&ksm_table, &f->ksm_elem);
+		f->ksm_listed = false;
+	}
+	list_remove(&f->frame_elem);
+	frame_cnt--;
+}
+
+/* Return a free frame, taken from the free frame list.
+ * If the list is empty, first evict a batch of pages onto it,
+ * so that the next allocations do not have to touch the disk.
  * Return NULL on error.*/
 static struct frame *
 vm_evict_frame(void)
 {
-	struct frame *victim = vm_get_victim();
-	/* TODO: swap out the victim and return the evicted frame. */
-	if (victim == NULL)
+	struct frame *frame = NULL;
+
+	lock_acquire(&frame_lock);
+	while (list_empty(&free_frames))
 	{
-		return NULL;
+		size_t freed;
+
+		lock_release(&frame_lock);
+		freed = vm_evict_batch();
+		if (freed == 0)
+			return NULL;
+		lock_acquire(&frame_lock);
+		direct_evict_cnt += freed;
 	}
-	struct page *page = victim->page;
-	if (page != NULL)
+	frame = list_entry(list_pop_front(&free_frames), struct frame, frame_elem);
+	free_frame_cnt--;
+	lock_release(&frame_lock);
+	return frame;
+}
+
+/* Marks VICTIM's page as swapped out and puts VICTIM on the free
+ * frame list.  Wakes threads waiting in vm_wait_evict(). */
+static void
+vm_release_victim(struct frame *victim)
+{
+	lock_acquire(&frame_lock);
+	victim->page->frame = NULL;
+	victim->page = NULL;
+	victim->evicting = false;
+	list_push_back(&free_frames, &victim->frame_elem);
+	free_frame_cnt++;
+	cond_broadcast(&evict_done, &frame_lock);
+	lock_release(&frame_lock);
+}
+
+/* Puts VICTIM, whose page could not be swapped out, back on the
+ * frame table.  Wakes threads waiting in vm_wait_evict(). */
+static void
+vm_restore_victim(struct frame *victim)
+{
+	lock_acquire(&frame_lock);
+	victim->evicting = false;
+	list_push_back(&frame_table, &victim->frame_elem);
+	frame_cnt++;
+	cond_broadcast(&evict_done, &frame_lock);
+	lock_release(&frame_lock);
+}
+
+/* If PAGE's frame is being evicted, waits until it is swapped out or
+ * put back and returns true; otherwise returns false at once.  The
+ * evictor keeps using PAGE and its frame until then, so PAGE must
+ * not be destroyed or given another frame before this returns. */
+bool vm_wait_evict(struct page *page)
+{
+	bool waited = false;
+
+	lock_acquire(&frame_lock);
+	while (page->frame != NULL && page->frame->evicting)
 	{
-		if (!swap_out(page))
+		cond_wait(&evict_done, &frame_lock);
+		waited = true;
+	}
+	lock_release(&frame_lock);
+	return waited;
+}
+
+/* Called first when PAGE is destroyed.  Waits like vm_wait_evict()
+ * if PAGE's frame is being evicted, and then keeps the frame from
+ * being picked for eviction, or by ksmd or the flusher, while PAGE
+ * is torn down. */
+void vm_destroy_begin(struct page *page)
+{
+	lock_acquire(&frame_lock);
+	while (page->frame != NULL && page->frame->evicting)
+		cond_wait(&evict_done, &frame_lock);
+	if (page->frame != NULL && page->frame->page == page)
+		page->frame->page = NULL;
+	lock_release(&frame_lock);
+}
+
+/* Evict up to VM_EVICT_BATCH pages and put their frames on the
+ * free frame list.  Returns the number of frames freed.
+ * The victims are taken off the frame table while they are written
+ * out, so no other thread can pick them and frame_lock is not held
+ * during I/O.  Anonymous victims are swapped out together, so that
+ * their writes reach the disk as a few large transfers.  Destroying
+ * a victim's page meanwhile waits in vm_destroy_begin() until the
+ * victim is released or restored. */
+static size_t
+vm_evict_batch(void)
+{
+	struct frame *file_victims[VM_EVICT_BATCH];
+	struct page *anon_pages[VM_EVICT_BATCH];
+	size_t anon_cnt = 0, file_cnt = 0, freed = 0, i;
+
+	lock_acquire(&frame_lock);
+	while (anon_cnt + file_cnt < VM_EVICT_BATCH)
+	{
+		struct frame *victim = vm_get_victim();
+		if (victim == NULL)
+			break;
+		frame_table_remove(victim);
+		victim->evicting = true;
+		if (VM_TYPE(victim->page->operations->type) == VM_ANON)
+			anon_pages[anon_cnt++] = victim->page;
+		else
+			file_victims[file_cnt++] = victim;
+	}
+	lock_release(&frame_lock);
+
+	/* TODO: swap out the victim and return the evicted frame. */
+	// 익명 페이지부터: 이 페이지들에 fault한 thread는 filesys_lock을 쥔 채
+	// 기다릴 수 있으므로, filesys_lock이 필요한 파일 페이지보다 먼저 끝낸다
+	if (anon_cnt > 0)
+	{
+		// 한 번에 swap out, 성공한 페이지가 앞쪽으로 온다
+		size_t swapped = anon_swap_out_batch(anon_pages, anon_cnt);
+		for (i = 0; i < anon_cnt; i++)
+			if (i < swapped)
+				vm_release_victim(anon_pages[i]->frame);
+			else
+				vm_restore_victim(anon_pages[i]->frame);
+		freed += swapped;
+	}
+
+	for (i = 0; i < file_cnt; i++)
+		if (swap_out(file_victims[i]->page))
 		{
-			return NULL;
+			vm_release_victim(file_victims[i]);
+			freed++;
 		}
-		page->frame = NULL;
-	}
-	victim->page = NULL;
-	return victim;
+		else
+			vm_restore_victim(file_victims[i]);
+	return freed;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
@@ -198,7 +606,10 @@ vm_get_frame(void)
 {
 	struct frame *frame = NULL;
 	/* TODO: Fill this function. */
-	void *new_kva = palloc_get_page(PAL_USER | PAL_ZERO); // 0으로 초기화 해야되나??
+	// swap_in()이 페이지 전체를 채우므로 0으로 초기화하지 않는다
+	void *new_kva = palloc_get_page(PAL_USER);
+	while (new_kva == NULL && swap_cache_reclaim())
+		new_kva = palloc_get_page(PAL_USER);
 	if (new_kva != NULL)
 	{
 		frame = (struct frame *)malloc(sizeof(struct frame));
@@ -208,28 +619,481 @@ vm_get_frame(void)
 			return NULL;
 		}
 		frame->kva = new_kva;
-		frame->page = NULL;
-		frame->ref_count = 1;
-		list_push_back(&frame_table, &frame->frame_elem);
 	}
 	else
 	{
-		frame = vm_evict_frame();
+		// 미리 0으로 채워 둔 frame도 빈 메모리이므로 evict보다 먼저 사용
+		frame = zero_pool_take();
+		if (frame == NULL)
+			frame = vm_evict_frame();
 	}
 	if (frame == NULL)
 		PANIC("vm_get_frame: failed to get frame");
-	ASSERT(frame->page == NULL);
+	frame_table_add(frame, false);
 	return frame;
 }
 
-/* Growing the stack. */
+/* Like vm_get_frame(), but for a page that must start out zeroed.
+ * Takes a frame from the pre-zeroed pool if there is one and marks
+ * it zeroed, so the caller can skip clearing it. */
+static struct frame *
+vm_get_zeroed_frame(void)
+{
+	struct frame *frame = zero_pool_take();
+
+	lock_acquire(&frame_lock);
+	if (frame != NULL)
+		zero_pool_hit_cnt++;
+	else
+		zero_pool_miss_cnt++;
+	lock_release(&frame_lock);
+
+	if (frame == NULL)
+		return vm_get_frame();
+	frame_table_add(frame, true);
+	return frame;
+}
+
+/* Returns a frame for a page that is only expected to be used soon,
+ * such as a fault-around neighbour, or NULL if memory is short.
+ * Never evicts, and leaves the memory kswapd keeps free alone. */
+struct frame *
+vm_try_get_frame(void)
+{
+	struct frame *frame;
+	void *kva;
+
+	if (vm_free_frames() <= vm_wmark_high)
+		return NULL;
+	kva = palloc_get_page(PAL_USER);
+	if (kva == NULL)
+		return NULL;
+	frame = malloc(sizeof *frame);
+	if (frame == NULL)
+	{
+		palloc_free_page(kva);
+		return NULL;
+	}
+	frame->kva = kva;
+	frame_table_add(frame, false);
+	return frame;
+}
+
+/* Takes a frame out of the pre-zeroed pool and returns it, or NULL
+ * if the pool is empty.  Wakes vm_zero when the pool runs low. */
+static struct frame *
+zero_pool_take(void)
+{
+	struct frame *frame = NULL;
+	bool wake;
+
+	lock_acquire(&frame_lock);
+	if (!list_empty(&zero_pool))
+	{
+		frame = list_entry(list_pop_front(&zero_pool), struct frame, frame_elem);
+		zero_pool_cnt--;
+	}
+	wake = !zero_pool_refilling && zero_pool_cnt < VM_ZERO_POOL_MAX / 2;
+	if (wake)
+		zero_pool_refilling = true;
+	lock_release(&frame_lock);
+	if (wake)
+		sema_up(&zero_pool_wake);
+	return frame;
+}
+
+/* Resets FRAME for a new page and adds it to the frame table.
+ * ZEROED tells whether it holds only zeros. */
 static void
-vm_stack_growth(void *addr)
+frame_table_add(struct frame *frame, bool zeroed)
 {
-	if (vm_alloc_page(VM_ANON | VM_MARKER_0, addr, true))
+	frame->page = NULL;
+	frame->ref_count = 1;
+	frame->age = 0;
+	frame->zeroed = zeroed;
+	frame->lock_cnt = 0;
+	frame->evicting = false;
+	frame->ksm_sum = 0;
+	frame->ksm_listed = false;
+	frame->merged = false;
+	frame->share = NULL;
+	lock_acquire(&frame_lock);
+	list_push_back(&frame_table, &frame->frame_elem);
+	frame_cnt++;
+	// 남은 frame이 low watermark 아래면 kswapd를 깨운다
+	bool wake = !kswapd_running && vm_free_frames() < vm_wmark_low;
+	if (wake)
+		kswapd_running = true;
+	lock_release(&frame_lock);
+	if (wake)
+		sema_up(&kswapd_wake);
+}
+
+/* Fills the pool of pre-zeroed frames.  Runs at PRI_MIN, so it only
+ * gets the CPU when nothing else wants it, and stops before it
+ * would eat into the memory that kswapd keeps free. */
+static void
+vm_zero_thread(void *aux UNUSED)
+{
+	for (;;)
 	{
-		vm_claim_page(addr);
+		sema_down(&zero_pool_wake);
+		while (palloc_user_free_cnt() > vm_wmark_high)
+		{
+			void *kva;
+			struct frame *frame;
+			bool full;
+
+			// 이 스레드만 pool을 채우므로 확인한 뒤 넘칠 일은 없다
+			lock_acquire(&frame_lock);
+			full = zero_pool_cnt >= VM_ZERO_POOL_MAX;
+			lock_release(&frame_lock);
+			if (full || (kva = palloc_get_page(PAL_USER)) == NULL)
+				break;
+			frame = malloc(sizeof *frame);
+			if (frame == NULL)
+			{
+				palloc_free_page(kva);
+				break;
+			}
+			memset(kva, 0, PGSIZE);
+			frame->kva = kva;
+			lock_acquire(&frame_lock);
+			list_push_back(&zero_pool, &frame->frame_elem);
+			zero_pool_cnt++;
+			lock_release(&frame_lock);
+		}
+		lock_acquire(&frame_lock);
+		zero_pool_refilling = false;
+		lock_release(&frame_lock);
+	}
+}
+
+/* Returns the number of user frames that can be handed out without
+ * evicting: free pages in the user pool plus evicted frames.
+ * Called with and without frame_lock held, so the counters are read
+ * without it.  Each is a single aligned word, so a read sees either
+ * the old or the new value, and the sum is only compared against the
+ * watermarks to decide whether to wake kswapd, evict more or skip
+ * optional work such as readahead.  A count that is off by a frame
+ * or two at that moment is harmless. */
+static size_t
+vm_free_frames(void)
+{
+	return palloc_user_free_cnt() + free_frame_cnt + zero_pool_cnt;
+}
+
+/* Page reclaim daemon.  Sleeps until vm_get_frame() sees the free
+ * frames fall below the low watermark, then evicts batches of pages
+ * onto the free frame list until the high watermark is reached, so
+ * that page faults rarely have to evict themselves. */
+static void
+vm_kswapd(void *aux UNUSED)
+{
+	for (;;)
+	{
+		sema_down(&kswapd_wake);
+		kswapd_wake_cnt++;
+		while (vm_free_frames() < vm_wmark_high)
+		{
+			size_t freed = vm_evict_batch();
+			if (freed == 0)
+				break;
+			lock_acquire(&frame_lock);
+			kswapd_evict_cnt += freed;
+			lock_release(&frame_lock);
+		}
+		lock_acquire(&frame_lock);
+		kswapd_running = false;
+		lock_release(&frame_lock);
+	}
+}
+
+/* One aging pass: shift each resident page's accessed bit into its
+ * frame's age and clear the bit for the next period. */
+static void
+vm_age_frames(void)
+{
+	struct list_elem *e;
+
+	lock_acquire(&frame_lock);
+	for (e = list_begin(&frame_table); e != list_end(&frame_table); e = list_next(e))
+	{
+		struct frame *f = list_entry(e, struct frame, frame_elem);
+		struct page *page = f->page;
+		if (page == NULL)
+			continue;
+
+		bool accessed = pml4_is_accessed(page->pml4, page->va);
+		f->age = (f->age >> 1) | (accessed ? VM_AGE_RECENT : 0);
+		if (accessed)
+			pml4_set_accessed(page->pml4, page->va, false);
 	}
+	lock_release(&frame_lock);
+}
+
+/* Kernel thread that periodically runs the aging pass. */
+static void
+vm_aging_thread(void *aux UNUSED)
+{
+	for (;;)
+	{
+		timer_sleep(VM_AGING_INTERVAL);
+		vm_age_frames();
+	}
+}
+
+/* Returns true if F holds a dirty page of a writable file mapping
+ * that is not shared with another process.  frame_lock must be
+ * held. */
+static bool
+frame_needs_flush(struct frame *f)
+{
+	struct page *page = f->page;
+
+	return page != NULL && f->ref_count == 1 && page->operations->type == VM_FILE && page->writable && page->file.file != NULL && pml4_is_dirty(page->pml4, page->va);
+}
+
+/* Writes back up to VM_FLUSH_BATCH dirty file-backed pages, looking
+ * at each frame at most once.  Each frame is pinned by a reference
+ * while it is written, and filesys_lock, held throughout, keeps the
+ * page's file open even if the page is destroyed meanwhile.  The
+ * dirty bit is cleared before the write, so a write to the page while
+ * it is on its way to disk makes it dirty again. */
+static void
+vm_flush_batch(void)
+{
+	size_t scanned = 0, written = 0;
+
+	lock_acquire(&filesys_lock);
+	while (written < VM_FLUSH_BATCH)
+	{
+		struct frame *f = NULL;
+		struct file *file = NULL;
+		off_t ofs = 0;
+		size_t bytes = 0;
+
+		lock_acquire(&frame_lock);
+		while (f == NULL && scanned < frame_cnt)
+		{
+			struct frame *c;
+
+			if (flush_cursor == list_end(&frame_table))
+				flush_cursor = list_begin(&frame_table);
+			c = list_entry(flush_cursor, struct frame, frame_elem);
+			flush_cursor = list_next(flush_cursor);
+			scanned++;
+			if (frame_needs_flush(c))
+				f = c;
+		}
+		if (f != NULL)
+		{
+			struct page *page = f->page;
+
+			pml4_set_dirty(page->pml4, page->va, false);
+			file = page->file.file;
+			ofs = page->file.offset;
+			bytes = page->file.page_read_bytes;
+			f->ref_count++;
+		}
+		lock_release(&frame_lock);
+		if (f == NULL)
+			break;
+
+		file_write_at(file, f->kva, bytes, ofs);
+		vm_unref_frame(f);
+		written++;
+	}
+	flush_cnt += written;
+	lock_release(&filesys_lock);
+}
+
+/* Writeback thread. */
+static void
+vm_flusher(void *aux UNUSED)
+{
+	for (;;)
+	{
+		timer_msleep(vm_flush_interval);
+		vm_flush_batch();
+	}
+}
+
+/* Writes the dirty pages of file mappings of the current process in
+ * the page aligned range START...END back to their files now, for
+ * msync(MS_SYNC). */
+void vm_sync(void *start, void *end)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *va;
+
+	lock_acquire(&filesys_lock);
+	for (va = start; va < (uint8_t *)end; va += PGSIZE)
+	{
+		struct page *page = spt_peek_page(spt, va);
+
+		if (page == NULL || page->operations->type != VM_FILE || !page->writable || page->frame == NULL || page->file.file == NULL || !pml4_is_dirty(page->pml4, page->va))
+			continue;
+		pml4_set_dirty(page->pml4, page->va, false);
+		file_write_at(page->file.file, page->frame->kva, page->file.page_read_bytes, page->file.offset);
+		sync_cnt++;
+	}
+	lock_release(&filesys_lock);
+}
+
+/* Returns true if F holds a page that ksmd may merge into another
+ * frame: an anonymous page that is the frame's only user, and whose
+ * owner is not in the middle of a kernel write into its memory.
+ * frame_lock must be held. */
+static bool
+ksm_can_merge(struct frame *f)
+{
+	struct page *page = f->page;
+	return page != NULL && f->ref_count == 1 && f->lock_cnt == 0 && VM_TYPE(page->operations->type) == VM_ANON && page->spt->pin_cnt == 0;
+}
+
+/* Maps F's page read-only onto G, which must hold the same bytes,
+ * and takes the page off F.  G's own mapping is made read-only too
+ * if its page was not shared yet.  Returns false, changing nothing,
+ * if the contents differ.  frame_lock must be held. */
+static bool
+ksm_merge(struct frame *f, struct frame *g)
+{
+	struct page *page = f->page;
+	enum intr_level old_level;
+	bool same;
+
+	// 비교부터 매핑 변경까지 다른 thread가 두 페이지에 쓰지 못하도록
+	old_level = intr_disable();
+	same = memcmp(f->kva, g->kva, PGSIZE) == 0;
+	if (same)
+	{
+		if (g->ref_count == 1)
+			pml4_set_page(g->page->pml4, g->page->va, g->kva, false);
+		pml4_set_page(page->pml4, page->va, g->kva, false);
+		g->ref_count++;
+		g->merged = g != &zero_frame;
+		page->frame = g;
+		f->page = NULL;
+	}
+	intr_set_level(old_level);
+	return same;
+}
+
+/* Looks at the frame under ksm_cursor and advances the cursor.
+ * A page whose checksum is the same as on the last pass is merged
+ * with the candidate that has that checksum, or becomes the
+ * candidate itself; pages that changed in between are likely to
+ * change again and are left alone.  Returns the frame the page
+ * left if it was merged, for the caller to free, or NULL. */
+static struct frame *
+ksm_scan_frame(void)
+{
+	struct frame *f, *g = NULL;
+	struct hash_elem *e;
+	uint64_t sum;
+
+	lock_acquire(&frame_lock);
+	if (ksm_cursor == list_end(&frame_table))
+		ksm_cursor = list_begin(&frame_table);
+	if (ksm_cursor == list_end(&frame_table))
+	{
+		lock_release(&frame_lock);
+		return NULL;
+	}
+	f = list_entry(ksm_cursor, struct frame, frame_elem);
+	ksm_cursor = list_next(ksm_cursor);
+	ksm_scan_cnt++;
+	if (!ksm_can_merge(f))
+		goto done;
+
+	sum = hash_bytes(f->kva, PGSIZE);
+	if (sum != f->ksm_sum)
+	{
+		// 지난번 이후 바뀐 페이지: checksum만 기록
+		if (f->ksm_listed)
+		{
+			hash_delete(&ksm_table, &f->ksm_elem);
+			f->ksm_listed = false;
+		}
+		f->ksm_sum = sum;
+		goto done;
+	}
+
+	if (sum == ksm_zero_sum)
+		g = &zero_frame;
+	else if ((e = hash_find(&ksm_table, &f->ksm_elem)) != NULL)
+		g = hash_entry(e, struct frame, ksm_elem);
+	if (g == f)
+		goto done;
+
+	// 공유 중인 frame의 매핑은 모두 read-only이므로 그대로 합칠 수 있다
+	if (g != NULL && (g == &zero_frame || g->ref_count > 1 || ksm_can_merge(g)) && ksm_merge(f, g))
+	{
+		ksm_merge_cnt++;
+		if (g == &zero_frame)
+			ksm_zero_merge_cnt++;
+		frame_table_remove(f);
+		lock_release(&frame_lock);
+		return f;
+	}
+
+	// 후보가 없거나 내용이 달라졌으면 이 frame이 새 후보가 된다
+	if (g != NULL && g != &zero_frame)
+	{
+		hash_delete(&ksm_table, &g->ksm_elem);
+		g->ksm_listed = false;
+	}
+	if (g != &zero_frame)
+	{
+		hash_insert(&ksm_table, &f->ksm_elem);
+		f->ksm_listed = true;
+	}
+done:
+	lock_release(&frame_lock);
+	return NULL;
+}
+
+/* Same-page merging daemon. */
+static void
+vm_ksmd(void *aux UNUSED)
+{
+	for (;;)
+	{
+		size_t cnt, i;
+
+		timer_sleep(VM_KSM_INTERVAL);
+		cnt = vm_ksm_pages < frame_cnt ? vm_ksm_pages : frame_cnt;
+		for (i = 0; i < cnt; i++)
+		{
+			struct frame *f = ksm_scan_frame();
+			if (f != NULL)
+			{
+				palloc_free_page(f->kva);
+				free(f);
+			}
+		}
+	}
+}
+
+static uint64_t
+ksm_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	return hash_entry(e, struct frame, ksm_elem)->ksm_sum;
+}
+
+static bool
+ksm_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+{
+	return hash_entry(a, struct frame, ksm_elem)->ksm_sum < hash_entry(b, struct frame, ksm_elem)->ksm_sum;
+}
+
+/* Growing the stack. */
+static void
+vm_stack_growth(void *addr)
+{
+	// frame은 fault 처리에서 할당 (읽기면 zero page)
+	vm_alloc_page(VM_ANON | VM_MARKER_0, addr, true);
 }
 
 /* Handle the fault on write_protected page */
@@ -240,22 +1104,56 @@ vm_handle_wp(struct page *page)
 	{
 		return false;
 	}
-	struct frame *old_frame = page->frame;
+	struct frame *old_frame, *new_frame;
+	bool ok, last;
 
 	// ref_count가 1이면 이 페이지를 사용하는 프로세스가 하나뿐이므로
 	// 새 프레임을 할당할 필요 없이 쓰기 권한만 복원
+	lock_acquire(&frame_lock);
+	old_frame = page->frame;
+	if (old_frame->evicting && VM_TYPE(page->operations->type) == VM_ANON)
+	{
+		// swap out 중인 익명 페이지는 매핑이 내려가 있다: 끝난 뒤 다시 접근
+		lock_release(&frame_lock);
+		vm_wait_evict(page);
+		return true;
+	}
 	if (old_frame->ref_count == 1)
 	{
-		return pml4_set_page(page->pml4, page->va, old_frame->kva, page->writable);
+		old_frame->page = page;
+		ok = pml4_set_page(page->pml4, page->va, old_frame->kva, page->writable);
+		lock_release(&frame_lock);
+		return ok;
 	}
+	// 복사하는 동안 evict나 KSM이 이 frame을 이 페이지의 것으로 보지 않도록
+	if (old_frame->page == page)
+		old_frame->page = NULL;
+	lock_release(&frame_lock);
 
 	// ref_count가 2 이상이면 실제로 페이지를 복사
-	struct frame *new_frame = vm_get_frame();
+	// zero page라면 복사 대신 0으로 채운 frame을 사용
+	new_frame = old_frame == &zero_frame ? vm_get_zeroed_frame() : vm_get_frame();
+	if (old_frame != &zero_frame)
+		memcpy(new_frame->kva, old_frame->kva, PGSIZE);
+	else if (!new_frame->zeroed)
+		memset(new_frame->kva, 0, PGSIZE);
+
+	lock_acquire(&frame_lock);
 	new_frame->page = page;
 	page->frame = new_frame;
-
-	memcpy(new_frame->kva, old_frame->kva, PGSIZE);
-	old_frame->ref_count--;
+	// 잠긴 페이지는 새 frame을 잠근다
+	if (page->locked)
+	{
+		old_frame->lock_cnt--;
+		new_frame->lock_cnt++;
+	}
+	if (old_frame->merged)
+		ksm_unmerge_cnt++;
+	// 복사하는 사이 다른 공유자가 모두 떠났을 수 있다
+	last = --old_frame->ref_count == 0;
+	lock_release(&frame_lock);
+	if (last)
+		vm_free_frame(old_frame);
 
 	return pml4_set_page(page->pml4, page->va, page->frame->kva, page->writable);
 }
@@ -275,7 +1173,7 @@ bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write
 		{
 			rsp = thread_current()->rsp;
 		}
-		if (addr < (USER_STACK - (1 << 20)) || addr >= USER_STACK || addr < rsp - 8)
+		if (addr < (USER_STACK - STACK_MAX_SIZE) || addr >= USER_STACK || addr < rsp - 8)
 		{
 			return false;
 		}
@@ -290,6 +1188,11 @@ bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write
 	{
 		return false;
 	}
+	// swap out 중이라 매핑이 내려간 페이지는 끝나기를 기다렸다가 다시 접근
+	if (not_present && vm_wait_evict(page))
+	{
+		return true;
+	}
 	// COW: write fault on a read-only page with a frame (shared)
 	if (write && !not_present && page->frame != NULL && page->frame->ref_count > 1)
 	{
@@ -300,12 +1203,343 @@ bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write
 	{
 		return vm_handle_wp(page);
 	}
-	bool result = vm_do_claim_page(page);
-	if (result)
+	// 아직 쓰지 않은 zero-fill 페이지를 읽기만 하면 zero page를 매핑
+	if (!write && page_is_zero_fill(page))
+	{
+		return vm_map_zero_page(page);
+	}
+	if (write && vm_large_pages && page_is_zero_fill(page) && vm_map_large(page))
+	{
+		return true;
+	}
+	if (!vm_do_claim_page(page))
+	{
+		return false;
+	}
+	/* A page that s_read() unshared may have been evicted and swapped
+	 * back in onto a frame shared with its fork siblings.  The kernel
+	 * ignores read-only mappings, so give it its own frame before a
+	 * kernel write lands in the siblings' copy. */
+	if (write && !user && !vm_unshare_page(page))
+	{
+		return false;
+	}
+	vm_drop_behind(page);
+	return true;
+}
+
+/* If PAGE, which just faulted in, lies in a region advised with
+ * MADV_SEQUENTIAL, makes the resident pages some way behind it the
+ * first candidates for eviction, since they will not be used again. */
+static void
+vm_drop_behind(struct page *page)
+{
+	uint8_t *va;
+
+	if ((uint64_t)page->va < 2 * VM_DROP_BEHIND * PGSIZE || vma_advice_at(page->spt, page->va) != VMA_ADV_SEQUENTIAL)
+		return;
+	for (va = (uint8_t *)page->va - 2 * VM_DROP_BEHIND * PGSIZE; va < (uint8_t *)page->va - VM_DROP_BEHIND * PGSIZE; va += PGSIZE)
+	{
+		struct page *p = spt_peek_page(page->spt, va);
+
+		if (p == NULL || p->frame == NULL)
+			continue;
+		lock_acquire(&frame_lock);
+		if (p->frame != NULL && p->frame->page == p && p->frame->age != 0)
+		{
+			p->frame->age = 0;
+			pml4_set_accessed(p->pml4, p->va, false);
+			drop_behind_cnt++;
+		}
+		lock_release(&frame_lock);
+	}
+}
+
+/* Reads in the pages of the current process in the page aligned
+ * range START...END that are not in memory, for madvise(MADV_WILLNEED).
+ * Swapped out anonymous pages are read into the swap cache without
+ * waiting; file data is read in and mapped, with fault-around.  Pages
+ * that start out zeroed are left alone.  Stops when frames could no
+ * longer be had without evicting. */
+void vm_prefetch(void *start, void *end)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *va;
+
+	for (va = start; va < (uint8_t *)end; va += PGSIZE)
+	{
+		struct page *page;
+
+		if (vm_free_frames() <= vm_wmark_high)
+			break;
+		page = spt_peek_page(spt, va);
+		if (page == NULL)
+		{
+			// 파일 데이터가 없는 페이지는 만들지 않는다
+			struct vma *vma = vma_find(spt, va);
+			if (vma == NULL || (size_t)(va - (uint8_t *)vma->start) >= vma->read_bytes)
+				continue;
+			if ((page = vma_page_in(spt, va)) == NULL)
+				break;
+		}
+		if (page->frame != NULL || page_is_zero_fill(page))
+			continue;
+		if (!anon_prefetch(page) && !vm_do_claim_page(page))
+			break;
+		prefetch_cnt++;
+	}
+}
+
+/* Drops the anonymous pages of the current process in the page
+ * aligned range START...END, with their frames and swap slots, for
+ * madvise(MADV_DONTNEED).  The next access to one finds it as it
+ * started out: zeroed, or loaded again from its region's file.
+ * Other pages, and locked ones, are left alone. */
+void vm_discard(void *start, void *end)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *va;
+
+	for (va = start; va < (uint8_t *)end; va += PGSIZE)
+	{
+		struct page *page = spt_peek_page(spt, va);
+		bool writable;
+
+		if (page == NULL || page->operations->type != VM_ANON || page->locked)
+			continue;
+		writable = page->writable;
+		spt_remove_page(spt, page);
+		// region 밖의 익명 페이지는 스택이다: 0으로 다시 시작
+		if (vma_find(spt, va) == NULL)
+			vm_alloc_page(VM_ANON | VM_MARKER_0, va, writable);
+		discard_cnt++;
+	}
+}
+
+/* Faults in the pages of the current process in the page aligned
+ * range START...END that are not in memory, for mmap(MAP_POPULATE),
+ * evicting other pages if it must.  File data is read with the
+ * fault-around reads of the regions' advice. */
+void vm_populate(void *start, void *end)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *va;
+
+	for (va = start; va < (uint8_t *)end; va += PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, va);
+
+		if (page != NULL && page->frame == NULL && !vm_do_claim_page(page))
+			break;
+	}
+}
+
+/* Locks the pages of the current process in the page aligned range
+ * START...END in memory, for mlock(), faulting them in first.  Fails,
+ * locking nothing, if part of the range is not mapped or the process
+ * would have more than vm_mlock_limit pages locked.  May fail having
+ * locked part of the range if memory runs out. */
+bool vm_mlock(void *start, void *end)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	size_t new_cnt = 0;
+	uint8_t *va;
+
+	for (va = start; va < (uint8_t *)end; va += PGSIZE)
+	{
+		struct page *page = spt_peek_page(spt, va);
+
+		if (page == NULL && vma_find(spt, va) == NULL)
+			return false;
+		if (page == NULL || !page->locked)
+			new_cnt++;
+	}
+	if (spt->locked_cnt + new_cnt > vm_mlock_limit)
+	{
+		mlock_refuse_cnt++;
+		return false;
+	}
+	for (va = start; va < (uint8_t *)end; va += PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, va);
+
+		if (page == NULL || !vm_lock_page(page))
+			return false;
+	}
+	return true;
+}
+
+/* Unlocks the locked pages of the current process in the page
+ * aligned range START...END, for munlock(). */
+void vm_munlock(void *start, void *end)
+{
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	uint8_t *va;
+
+	for (va = start; va < (uint8_t *)end; va += PGSIZE)
+	{
+		struct page *page = spt_peek_page(spt, va);
+
+		if (page == NULL || !page->locked)
+			continue;
+		lock_acquire(&frame_lock);
+		page_unlock(page);
+		lock_release(&frame_lock);
+	}
+}
+
+/* Brings PAGE into memory and locks it there.  A writable page gets
+ * a frame of its own first, so that writing it never needs a new
+ * one.  Returns false if out of memory. */
+static bool
+vm_lock_page(struct page *page)
+{
+	while (!page->locked)
 	{
-		page->last_used_tick = timer_ticks();
+		// 이미 evict 중인 frame은 잠글 수 없다: 끝나기를 기다려 다시 올린다
+		vm_wait_evict(page);
+		if (page->frame == NULL && !vm_do_claim_page(page))
+			return false;
+		if (page->writable && !vm_unshare_page(page))
+			return false;
+
+		lock_acquire(&frame_lock);
+		if (page->frame != NULL && !page->frame->evicting)
+		{
+			page->locked = true;
+			page->frame->lock_cnt++;
+			page->spt->locked_cnt++;
+			if (++mlock_cnt > mlock_peak)
+				mlock_peak = mlock_cnt;
+		}
+		lock_release(&frame_lock);
 	}
-	return result;
+	return true;
+}
+
+/* Unlocks PAGE if it is locked.  frame_lock must be held. */
+static void
+page_unlock(struct page *page)
+{
+	if (!page->locked)
+		return;
+	page->locked = false;
+	page->frame->lock_cnt--;
+	page->spt->locked_cnt--;
+	mlock_cnt--;
+}
+
+/* Maps the 2 MB aligned stretch around PAGE, a zero-fill page being
+ * written, with one 2 MB page of zeros, if the stretch lies in one
+ * writable anonymous region, none of its pages has been touched and
+ * memory is plentiful.  Returns false, changing nothing but possibly
+ * creating some of the stretch's pages, if it does not. */
+static bool
+vm_map_large(struct page *page)
+{
+	struct supplemental_page_table *spt = page->spt;
+	void *base = (void *)((uint64_t)page->va & ~(LARGE_PGSIZE - 1));
+	void *end = base + LARGE_PGSIZE;
+	size_t cnt = LARGE_PGSIZE / PGSIZE;
+	struct vma *vma = vma_find(spt, page->va);
+	struct list frames;
+	uint8_t *kva;
+	void *va;
+
+	if (vma == NULL || vma->type != VM_ANON || !vma->writable || vma->start > base || vma->end < end || vma->read_bytes > (size_t)(base - vma->start))
+		return false;
+	// 겹치는 region이 없어야 한다 (실행 파일 segment 경계)
+	if (vma_find(spt, base) != vma || vma_find(spt, end - PGSIZE) != vma)
+		return false;
+	for (va = base; va < end; va += PGSIZE)
+	{
+		struct page *p = spt_peek_page(spt, va);
+		if (p != NULL && !page_is_zero_fill(p))
+			return false;
+	}
+	// 큰 페이지 때문에 evict하지 않는다
+	if (vm_free_frames() <= vm_wmark_high + cnt)
+		return false;
+	kva = palloc_get_aligned(PAL_USER | PAL_ZERO, cnt);
+	if (kva == NULL)
+	{
+		large_fail_cnt++;
+		return false;
+	}
+
+	/* Make every page and frame before mapping, so that nothing
+	 * needs undoing once the 2 MB page is in place. */
+	list_init(&frames);
+	for (va = base; va < end; va += PGSIZE)
+	{
+		struct frame *frame;
+
+		if (spt_peek_page(spt, va) == NULL && !vm_alloc_page(VM_ANON, va, vma->writable))
+			goto fail;
+		frame = malloc(sizeof *frame);
+		if (frame == NULL)
+			goto fail;
+		frame->kva = kva + (va - base);
+		list_push_back(&frames, &frame->frame_elem);
+	}
+	if (!pml4_set_large_page(page->pml4, base, kva, vma->writable))
+		goto fail;
+
+	for (va = base; va < end; va += PGSIZE)
+	{
+		struct page *p = spt_peek_page(spt, va);
+		struct frame *frame = list_entry(list_pop_front(&frames), struct frame, frame_elem);
+
+		p->uninit.page_initializer(p, p->uninit.type, frame->kva);
+		frame_table_add(frame, true);
+		frame->page = p;
+		p->frame = frame;
+	}
+	large_map_cnt++;
+	return true;
+
+fail:
+	while (!list_empty(&frames))
+		free(list_entry(list_pop_front(&frames), struct frame, frame_elem));
+	palloc_free_multiple(kva, cnt);
+	return false;
+}
+
+/* Returns true if PAGE is an anonymous page that has not been
+ * materialized yet and starts out as all zeros. */
+static bool
+page_is_zero_fill(struct page *page)
+{
+	return page->operations->type == VM_UNINIT && VM_TYPE(page->uninit.type) == VM_ANON && page->uninit.init == NULL;
+}
+
+/* Maps the shared zero frame read-only at PAGE, an anonymous page
+ * that is still all zeros, turning it into an anonymous page
+ * without allocating a frame.  The first write copies it through
+ * vm_handle_wp(). */
+static bool
+vm_map_zero_page(struct page *page)
+{
+	struct uninit_page *uninit = &page->uninit;
+
+	if (!uninit->page_initializer(page, uninit->type, NULL))
+		return false;
+	lock_acquire(&frame_lock);
+	zero_frame.ref_count++;
+	lock_release(&frame_lock);
+	page->frame = &zero_frame;
+	return pml4_set_page(page->pml4, page->va, zero_frame.kva, false);
+}
+
+/* Gives PAGE a frame of its own if it shares one through COW or
+ * the zero page, so that the kernel can write to it directly.
+ * The kernel does not honor read-only user mappings, so it must
+ * be called before the kernel writes into a user buffer. */
+bool vm_unshare_page(struct page *page)
+{
+	if (page->frame != NULL && page->frame->ref_count > 1)
+		return vm_handle_wp(page);
+	return true;
 }
 
 /* Free the page.
@@ -316,6 +1550,73 @@ void vm_dealloc_page(struct page *page)
 	free(page);
 }
 
+/* Removes FRAME from the frame table and frees its memory.
+ * Keeps the clock hand pointing at a frame that is still in the table.
+ * FRAME must not be being evicted, which takes it off the table. */
+void vm_free_frame(struct frame *frame)
+{
+	ASSERT(!frame->evicting);
+	lock_acquire(&frame_lock);
+	frame_table_remove(frame);
+	lock_release(&frame_lock);
+	palloc_free_page(frame->kva);
+	free(frame);
+}
+
+/* Maps PAGE onto FRAME, which another page already uses, taking
+ * a reference to it.  PAGE becomes FRAME's owner if it has none. */
+void vm_share_frame(struct page *page, struct frame *frame)
+{
+	lock_acquire(&frame_lock);
+	frame->ref_count++;
+	if (frame->page == NULL)
+		frame->page = page;
+	page->frame = frame;
+	lock_release(&frame_lock);
+}
+
+/* Takes a reference to FRAME on behalf of something other than a
+ * page, which keeps FRAME from being evicted or freed. */
+void vm_ref_frame(struct frame *frame)
+{
+	lock_acquire(&frame_lock);
+	frame->ref_count++;
+	lock_release(&frame_lock);
+}
+
+/* Drops a reference taken with vm_ref_frame(), freeing FRAME if it
+ * was the last one. */
+void vm_unref_frame(struct frame *frame)
+{
+	bool last;
+
+	lock_acquire(&frame_lock);
+	last = --frame->ref_count == 0;
+	lock_release(&frame_lock);
+	if (last)
+		vm_free_frame(frame);
+}
+
+/* Drops PAGE's reference to its frame, which may be shared, and
+ * frees the frame if that was the last one.  Returns true if it
+ * was. */
+bool vm_put_frame(struct page *page)
+{
+	struct frame *frame = page->frame;
+	bool last;
+
+	lock_acquire(&frame_lock);
+	if (frame->page == page)
+		frame->page = NULL;
+	page_unlock(page);
+	last = --frame->ref_count == 0;
+	lock_release(&frame_lock);
+	page->frame = NULL;
+	if (last)
+		vm_free_frame(frame);
+	return last;
+}
+
 /* Claim the page that allocate on VA. */
 bool vm_claim_page(void *va)
 {
@@ -332,7 +1633,13 @@ bool vm_claim_page(void *va)
 static bool
 vm_do_claim_page(struct page *page)
 {
-	struct frame *frame = vm_get_frame();
+	struct frame *frame;
+
+	// 다른 프로세스가 이미 올려 둔 read-only 파일 페이지는 그대로 공유
+	// fork로 공유한 swap slot을 다른 페이지가 이미 읽었으면 그 frame을 COW로 공유
+	if (file_share_map(page) || anon_share_map(page))
+		return true;
+	frame = page_is_zero_fill(page) ? vm_get_zeroed_frame() : vm_get_frame();
 
 	/* Set links */
 	frame->page = page;
@@ -342,96 +1649,112 @@ vm_do_claim_page(struct page *page)
 	{
 		return false;
 	}
-	return swap_in(page, frame->kva); // lazy_loading
+	// 방금 올린 페이지가 clock에 바로 뽑히지 않도록 한 바퀴 유예
+	pml4_set_accessed(thread_current()->pml4, page->va, true);
+	if (!swap_in(page, frame->kva)) // lazy_loading
+		return false;
+	file_share_add(page);
+	return true;
 }
 
 /* Initialize new supplemental page table */
 void supplemental_page_table_init(struct supplemental_page_table *spt)
 {
 	hash_init(&spt->spt_hash, hash_hash, hash_less, NULL);
+	list_init(&spt->vmas);
+	spt->swap_cluster.next = spt->swap_cluster.end = 0;
+	spt->pin_cnt = 0;
+	spt->locked_cnt = 0;
+	spt->heap_start = spt->brk = NULL;
 }
 
-/* Copy supplemental page table from src to dst */
+/* Copy supplemental page table from src to dst.
+ * Nothing is read or copied: resident pages share their frames
+ * copy-on-write, swapped out anonymous pages share their swap
+ * slots, and pages not loaded yet share what they load from.
+ * Regions are copied whole, so pages never touched cost nothing. */
 bool supplemental_page_table_copy(struct supplemental_page_table *dst, struct supplemental_page_table *src)
 {
-	// todo: swap out상태라면 swap in 시켜서 사용해야함.
 	struct hash_iterator temp;
+
+	// region은 통째로 복사하고, 페이지는 이미 만들어진 것만 복사
+	if (!vma_copy(dst, src))
+		return false;
+	dst->heap_start = src->heap_start;
+	dst->brk = src->brk;
 	hash_first(&temp, &src->spt_hash);
 	while (hash_next(&temp))
 	{
 		struct page *src_page = hash_entry(hash_cur(&temp), struct page, hash_elem);
 		enum vm_type type = VM_TYPE(src_page->operations->type);
+		struct page *dst_page;
+		struct frame *frame;
+		bool mapped = true;
 
 		if (type == VM_UNINIT)
 		{
 			// UNINIT 페이지는 자식에게도 UNINIT으로 복사
-			// aux 데이터 복사 (file_reopen 필요)
-			struct new_aux *src_aux = (struct new_aux *)src_page->uninit.aux;
-			struct new_aux *new_aux = (struct new_aux *)malloc(sizeof(struct new_aux));
-			if (new_aux == NULL)
-			{
-				return false;
-			}
-			struct file *reopened_file = file_reopen(src_aux->file);
-			if (reopened_file == NULL)
-			{
-				free(new_aux);
-				return false;
-			}
-			new_aux->file = reopened_file;
-			new_aux->offset = src_aux->offset;
-			new_aux->page_read_bytes = src_aux->page_read_bytes;
-
-			// UNINIT 페이지 생성
+			// aux는 file_reopen 없이 참조만 늘려 공유 (load할 때 각자 연다)
+			struct new_aux *aux = (struct new_aux *)src_page->uninit.aux;
 			if (!vm_alloc_page_with_initializer(src_page->uninit.type, src_page->va,
-												src_page->writable, src_page->uninit.init, new_aux))
-			{
-				file_close(reopened_file);
-				free(new_aux);
+												src_page->writable, src_page->uninit.init, aux))
 				return false;
-			}
+			if (aux != NULL)
+				lazy_aux_get(aux);
+			continue;
 		}
-		else if (type == VM_ANON || type == VM_FILE)
+		if (type != VM_ANON && type != VM_FILE)
+			continue;
+
+		// 부모 페이지를 복사하되, frame과 swap slot은 아래에서 공유
+		dst_page = (struct page *)malloc(sizeof(struct page));
+		if (!dst_page)
+			return false;
+		memcpy(dst_page, src_page, sizeof(struct page));
+		dst_page->pml4 = thread_current()->pml4;
+		dst_page->spt = dst;
+		dst_page->frame = NULL;
+		dst_page->locked = false; // mlock은 자식에게 물려주지 않는다
+		if (type == VM_FILE)
 		{
-			// 실제 materialized된 페이지만 여기서 처리
-			if (src_page->frame == NULL)
-			{
-				// frame이 없으면 UNINIT이거나 swap out된 페이지
-				// 이 경우는 위의 UNINIT 처리에서 다뤄야 함
-				continue;
-			}
-			// 그냥 부모 페이지를 복사
-			struct page *dst_page = (struct page *)malloc(sizeof(struct page));
-			if (!dst_page)
-			{
-				return false;
-			}
-			memcpy(dst_page, src_page, sizeof(struct page));
-			dst_page->pml4 = thread_current()->pml4;
-			if (type == VM_FILE)
-			{
-				dst_page->file.file = file_reopen(src_page->file.file);
-			}
-			src_page->frame->ref_count++;
-			if (!spt_insert_page(dst, dst_page))
-				return false;
-			if (!pml4_set_page(src_page->pml4, src_page->va, src_page->frame->kva, false))
-				return false;
-			if (!pml4_set_page(dst_page->pml4, dst_page->va, src_page->frame->kva, false))
-				return false;
+			// 파일은 다시 열지 않고 참조만 공유
+			dst_page->file.share = NULL;
+			if (dst_page->file.ref != NULL)
+				file_ref_get(dst_page->file.ref);
+		}
+		else
+			dst_page->anon.swap_index = -1;
+		if (!spt_insert_page(dst, dst_page))
+		{
+			destroy(dst_page);
+			free(dst_page);
+			return false;
+		}
 
-			// //  이미 claim된 페이지는 물리 메모리를 복사
-			// if (!vm_alloc_page(type, src_page->va, src_page->writable))
-			// {
-			// 	return false;
-			// }
-			// if (!vm_claim_page(src_page->va))
-			// {
-			// 	return false;
-			// }
-			// struct page *dst_page = spt_find_page(dst, src_page->va);
-			// memcpy(dst_page->frame->kva, src_page->frame->kva, PGSIZE);
+		// read-only 파일 페이지: 자식은 fault할 때 공유 frame을 찾아 쓴다
+		if (type == VM_FILE && !src_page->writable)
+			continue;
+
+		// ksmd나 evict가 부모 페이지의 frame을 바꾸지 못하도록 frame_lock 아래에서 공유
+		lock_acquire(&frame_lock);
+		// evict 중인 frame은 free list로 갈 수 있으니 끝날 때까지 기다린다
+		while (src_page->frame != NULL && src_page->frame->evicting)
+			cond_wait(&evict_done, &frame_lock);
+		frame = src_page->frame;
+		if (frame != NULL)
+		{
+			dst_page->frame = frame;
+			frame->ref_count++;
+			mapped = pml4_set_page(src_page->pml4, src_page->va, frame->kva, false) && pml4_set_page(dst_page->pml4, dst_page->va, frame->kva, false);
 		}
+		lock_release(&frame_lock);
+		if (!mapped)
+			return false;
+
+		// swap out된 익명 페이지는 읽지 않고 swap slot을 공유
+		// 쓰기 가능한 파일 페이지는 frame이 없으면 파일에서 다시 읽으면 된다
+		if (frame == NULL && type == VM_ANON && src_page->anon.swap_index != (size_t)-1 && !anon_share_slot(dst_page, src_page))
+			return false;
 	}
 	return true;
 }
@@ -441,6 +1764,7 @@ void supplemental_page_table_kill(struct supplemental_page_table *spt)
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
 	hash_destroy(&spt->spt_hash, hash_destructor);
+	vma_kill(spt);
 }
 
 uint64_t hash_hash(const struct hash_elem *e, void *aux UNUSED)
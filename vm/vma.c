@@ -0,0 +1,383 @@
+/* vma.c: Regions of the address space whose pages are created on demand.
+ *
+ * Executable segments and file mappings used to get a struct page, a
+ * lazy-load aux and a reopened file for every page up front.  They are
+ * now kept as one region each, in a list sorted by address, and a page
+ * of a region gets its struct page, uninit as before, the first time
+ * spt_find_page() looks it up, which is normally its first fault.
+ * A region opens its file once, and its pages share that handle
+ * through a struct file_ref.  madvise() advice is kept per region,
+ * so advising part of a region splits it.  The heap that brk() moves
+ * is a region too, grown and shrunk at its end.
+ * Mapping, unmapping and forking thus cost time in proportion to the
+ * number of regions and of pages actually touched. */
+
+#include "vm/vma.h"
+#include <round.h>
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+
+static void vma_free(struct vma *vma);
+static struct vma *vma_split(struct vma *vma, void *at);
+static bool vma_start_less(const struct list_elem *a, const struct list_elem *b,
+						   void *aux);
+
+/* Adds a region of LENGTH bytes, rounded up to whole pages, at START
+ * to SPT.  Its pages are of TYPE and get their first READ_BYTES bytes
+ * from FILE, starting at OFFSET, and the rest are zeros.  FILE may be
+ * NULL if READ_BYTES is 0; otherwise the region opens a handle of its
+ * own for it, which all its pages share.  Does not check for overlap with other regions.
+ * Returns the region, or NULL if out of memory. */
+struct vma *
+vma_map(struct supplemental_page_table *spt, void *start, size_t length,
+		enum vm_type type, bool writable, struct file *file, off_t offset,
+		size_t read_bytes)
+{
+	struct vma *vma;
+
+	ASSERT(pg_ofs(start) == 0);
+	ASSERT(read_bytes <= length);
+
+	vma = malloc(sizeof *vma);
+	if (vma == NULL)
+		return NULL;
+	vma->start = start;
+	vma->end = start + ROUND_UP(length, PGSIZE);
+	vma->type = type;
+	vma->writable = writable;
+	vma->mmapped = false;
+	vma->split = false;
+	vma->advice = VMA_ADV_NORMAL;
+	vma->ref = NULL;
+	vma->offset = offset;
+	vma->read_bytes = read_bytes;
+	if (file != NULL && (vma->ref = file_ref_open(file)) == NULL)
+	{
+		free(vma);
+		return NULL;
+	}
+	list_insert_ordered(&spt->vmas, &vma->elem, vma_start_less, NULL);
+	return vma;
+}
+
+/* Removes VMA from SPT, destroying the pages of its range that have
+ * been created, which writes back those of file mappings. */
+void vma_unmap(struct supplemental_page_table *spt, struct vma *vma)
+{
+	void *va;
+
+	for (va = vma->start; va < vma->end; va += PGSIZE)
+	{
+		struct page *page = spt_peek_page(spt, va);
+		if (page != NULL)
+			spt_remove_page(spt, page);
+	}
+	list_remove(&vma->elem);
+	vma_free(vma);
+}
+
+/* Returns the region of SPT that contains VA, or NULL.  Where
+ * regions overlap, as the last page of one executable segment and
+ * the first of the next may, the one starting first wins. */
+struct vma *
+vma_find(struct supplemental_page_table *spt, void *va)
+{
+	struct list_elem *e;
+
+	for (e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e))
+	{
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if (va < vma->start)
+			break;
+		if (va < vma->end)
+			return vma;
+	}
+	return NULL;
+}
+
+/* Returns true if no region and no page of SPT lies in the page
+ * aligned range START...END.  Looks up each page of the range, or
+ * walks the pages of SPT, whichever is fewer. */
+bool vma_range_free(struct supplemental_page_table *spt, void *start, void *end)
+{
+	struct list_elem *e;
+	void *va;
+
+	for (e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e))
+	{
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if (vma->start >= end)
+			break;
+		if (vma->end > start)
+			return false;
+	}
+
+	if ((size_t)(end - start) / PGSIZE <= hash_size(&spt->spt_hash))
+	{
+		for (va = start; va < end; va += PGSIZE)
+			if (spt_peek_page(spt, va) != NULL)
+				return false;
+	}
+	else
+	{
+		struct hash_iterator i;
+
+		hash_first(&i, &spt->spt_hash);
+		while (hash_next(&i))
+		{
+			va = hash_entry(hash_cur(&i), struct page, hash_elem)->va;
+			if (va >= start && va < end)
+				return false;
+		}
+	}
+	return true;
+}
+
+/* Finds LENGTH bytes, rounded up to whole pages, of address space
+ * that no region of SPT uses, as high as possible below the room kept
+ * for the stack, and returns its start.  Returns NULL if there is no
+ * such space above the lowest region. */
+void *
+vma_find_free(struct supplemental_page_table *spt, size_t length)
+{
+	uint8_t *top = (uint8_t *)USER_STACK - STACK_MAX_SIZE;
+	struct list_elem *e;
+
+	length = ROUND_UP(length, PGSIZE);
+	if (length == 0 || length > (size_t)top)
+		return NULL;
+	// 위쪽 region부터 내려가며 그 위의 빈 곳을 본다
+	for (e = list_rbegin(&spt->vmas); e != list_rend(&spt->vmas); e = list_prev(e))
+	{
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if ((uint64_t)vma->end + length <= (uint64_t)top)
+			return top - length;
+		if ((uint8_t *)vma->start < top)
+			top = vma->start;
+	}
+	return NULL;
+}
+
+/* Places the heap of SPT, empty, just past its highest region, which
+ * for a program just loaded is the end of its bss. */
+void vma_heap_init(struct supplemental_page_table *spt)
+{
+	struct list_elem *e;
+	void *end = NULL;
+
+	for (e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e))
+	{
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if (vma->end > end)
+			end = vma->end;
+	}
+	spt->heap_start = spt->brk = end;
+}
+
+/* Moves the program break of SPT to ADDR and returns the new break.
+ * The heap is a region of zero-fill anonymous pages from heap_start
+ * up to the break rounded up to a page; pages it gains are created on
+ * demand, and pages it loses are destroyed.  Returns the old break,
+ * changing nothing, if ADDR is below heap_start, the heap would run
+ * into another region or the stack, or memory ran out. */
+void *
+vma_brk(struct supplemental_page_table *spt, void *addr)
+{
+	void *old_end = pg_round_up(spt->brk);
+	void *new_end = pg_round_up(addr);
+	struct vma *heap;
+
+	if (spt->heap_start == NULL || addr < spt->heap_start ||
+		(uint8_t *)new_end > (uint8_t *)USER_STACK - STACK_MAX_SIZE)
+		return spt->brk;
+
+	if (new_end > old_end)
+	{
+		if (!vma_range_free(spt, old_end, new_end))
+			return spt->brk;
+		// madvise로 나뉘었을 수 있으니 마지막 조각을 늘린다
+		heap = old_end > spt->heap_start ? vma_find(spt, old_end - PGSIZE) : NULL;
+		if (heap != NULL)
+			heap->end = new_end;
+		else if (vma_map(spt, spt->heap_start, new_end - spt->heap_start, VM_ANON,
+						 true, NULL, 0, 0) == NULL)
+			return spt->brk;
+	}
+	while (old_end > new_end)
+	{
+		heap = vma_find(spt, old_end - PGSIZE);
+		ASSERT(heap != NULL);
+		if (heap->start >= new_end)
+		{
+			old_end = heap->start;
+			vma_unmap(spt, heap);
+			continue;
+		}
+		for (void *va = new_end; va < old_end; va += PGSIZE)
+		{
+			struct page *page = spt_peek_page(spt, va);
+			if (page != NULL)
+				spt_remove_page(spt, page);
+		}
+		heap->end = old_end = new_end;
+	}
+	spt->brk = addr;
+	return addr;
+}
+
+/* Creates the page at VA, which must not exist yet, if VA lies in a
+ * region of SPT, the current process's, and returns it.  The page is
+ * uninit: it loads from the region's file, or starts out zeroed
+ * past the region's file data.  Returns NULL if VA is in no region
+ * or out of memory. */
+struct page *
+vma_page_in(struct supplemental_page_table *spt, void *va)
+{
+	struct vma *vma = vma_find(spt, va);
+	struct new_aux *aux;
+	size_t ofs, read_bytes;
+
+	if (vma == NULL)
+		return NULL;
+	ASSERT(spt == &thread_current()->spt);
+
+	ofs = va - vma->start;
+	read_bytes = vma->read_bytes > ofs ? vma->read_bytes - ofs : 0;
+	if (read_bytes > PGSIZE)
+		read_bytes = PGSIZE;
+
+	/* A page with nothing to read is zero-fill on demand: it
+	 * maps the shared zero page until it is first written. */
+	if (read_bytes == 0)
+		return vm_alloc_page(VM_ANON, va, vma->writable) ? spt_peek_page(spt, va) : NULL;
+
+	aux = malloc(sizeof *aux);
+	if (aux == NULL)
+		return NULL;
+	// 파일은 다시 열지 않고 region의 것을 참조
+	aux->ref = file_ref_get(vma->ref);
+	aux->file = aux->ref->file;
+	aux->offset = vma->offset + ofs;
+	aux->page_read_bytes = read_bytes;
+	aux->refs = 1;
+	if (!vm_alloc_page_with_initializer(vma->type, va, vma->writable, (vm_initializer *)lazy_load_segment, aux))
+	{
+		lazy_aux_put(aux);
+		return NULL;
+	}
+	return spt_peek_page(spt, va);
+}
+
+/* Sets the advice of the parts of SPT's regions that lie in the page
+ * aligned range START...END to ADVICE, splitting regions that lie
+ * only partly in it.  Returns false if out of memory. */
+bool vma_advise(struct supplemental_page_table *spt, void *start, void *end,
+				enum vma_advice advice)
+{
+	struct list_elem *e;
+
+	for (e = list_begin(&spt->vmas); e != list_end(&spt->vmas); e = list_next(e))
+	{
+		struct vma *vma = list_entry(e, struct vma, elem);
+		if (vma->start >= end)
+			break;
+		if (vma->end <= start || vma->advice == advice)
+			continue;
+		// 범위 앞부분은 떼어 두고, 다음 차례에 뒷부분을 본다
+		if (vma->start < start)
+		{
+			if (vma_split(vma, start) == NULL)
+				return false;
+			continue;
+		}
+		if (vma->end > end && vma_split(vma, end) == NULL)
+			return false;
+		vma->advice = advice;
+	}
+	return true;
+}
+
+/* Returns the advice of the region of SPT that contains VA, or
+ * VMA_ADV_NORMAL if there is none. */
+enum vma_advice
+vma_advice_at(struct supplemental_page_table *spt, void *va)
+{
+	struct vma *vma = vma_find(spt, va);
+	return vma != NULL ? vma->advice : VMA_ADV_NORMAL;
+}
+
+/* Copies the regions of SRC into DST, for fork.  Returns false if
+ * out of memory. */
+bool vma_copy(struct supplemental_page_table *dst, struct supplemental_page_table *src)
+{
+	struct list_elem *e;
+
+	for (e = list_begin(&src->vmas); e != list_end(&src->vmas); e = list_next(e))
+	{
+		struct vma *vma = list_entry(e, struct vma, elem);
+		struct vma *copy = vma_map(dst, vma->start, vma->end - vma->start, vma->type,
+								   vma->writable, NULL, vma->offset, vma->read_bytes);
+		if (copy == NULL)
+			return false;
+		// 자식도 같은 파일 참조를 공유
+		copy->ref = vma->ref != NULL ? file_ref_get(vma->ref) : NULL;
+		copy->mmapped = vma->mmapped;
+		copy->split = vma->split;
+		copy->advice = vma->advice;
+	}
+	return true;
+}
+
+/* Frees every region of SPT.  Their pages are destroyed along with
+ * the rest of SPT's pages. */
+void vma_kill(struct supplemental_page_table *spt)
+{
+	while (!list_empty(&spt->vmas))
+		vma_free(list_entry(list_pop_front(&spt->vmas), struct vma, elem));
+}
+
+/* Drops VMA's file reference and frees VMA. */
+static void
+vma_free(struct vma *vma)
+{
+	if (vma->ref != NULL)
+		file_ref_put(vma->ref);
+	free(vma);
+}
+
+/* Splits VMA at AT, a page inside it, into two regions, and returns
+ * the upper one, which follows VMA in the list, or NULL if out of
+ * memory. */
+static struct vma *
+vma_split(struct vma *vma, void *at)
+{
+	size_t ofs = at - vma->start;
+	struct vma *upper;
+
+	ASSERT(pg_ofs(at) == 0 && vma->start < at && at < vma->end);
+
+	upper = malloc(sizeof *upper);
+	if (upper == NULL)
+		return NULL;
+	*upper = *vma;
+	upper->start = at;
+	upper->split = true;
+	upper->offset = vma->offset + ofs;
+	upper->read_bytes = vma->read_bytes > ofs ? vma->read_bytes - ofs : 0;
+	if (upper->ref != NULL)
+		file_ref_get(upper->ref);
+	vma->end = at;
+	if (vma->read_bytes > ofs)
+		vma->read_bytes = ofs;
+	list_insert(list_next(&vma->elem), &upper->elem);
+	return upper;
+}
+
+static bool
+vma_start_less(const struct list_elem *a, const struct list_elem *b,
+			   void *aux UNUSED)
+{
+	return list_entry(a, struct vma, elem)->start < list_entry(b, struct vma, elem)->start;
+}
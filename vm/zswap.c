@@ -0,0 +1,381 @@
+/* zswap.c: Compressed cache in front of the swap disks.
+ *
+ * A page being swapped out is first compressed into a pool of kernel
+ * pages, and is written to its swap slot only if it does not compress
+ * well or the pool is full.  Compressed pages are kept by swap slot, so
+ * the slot stays allocated on disk but is never read or written.
+ *
+ * The compressor works on 64-bit words and encodes runs of zero words,
+ * runs of a repeated word, and literal words, which suits the zero
+ * filled and patterned pages user programs leave behind.  Each pool page
+ * holds up to two compressed pages, one at either end ("zbud"). */
+
+#include "vm/zswap.h"
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Words per page. */
+#define PAGE_WORDS (PGSIZE / sizeof(uint64_t))
+
+/* Pages that do not compress to at most this many bytes go to disk. */
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4)
+
+/* Token types, in the top two bits of a token byte.  The low six
+ * bits hold the number of words covered, minus one. */
+#define TOK_ZERO 0x00	 /* Run of zero words. */
+#define TOK_REPEAT 0x40	 /* Run of one word, which follows. */
+#define TOK_LITERAL 0x80 /* Literal words, which follow. */
+#define TOK_TYPE 0xc0
+#define TOK_MAX_RUN 64
+
+/* A pool page, holding up to two compressed pages. */
+struct zpage
+{
+	uint8_t *kva;
+	size_t first_len;	   /* Bytes used from the start, 0 if free. */
+	size_t last_len;	   /* Bytes used from the end, 0 if free. */
+	struct list_elem elem; /* unbuddied element, if a half is free. */
+};
+
+/* A compressed page. */
+struct zswap_entry
+{
+	struct hash_elem elem;
+	size_t slot;	   /* Global swap slot. */
+	struct zpage *zp;  /* Pool page holding the data. */
+	bool last;		   /* At the end of ZP rather than the start. */
+	size_t len;		   /* Compressed length in bytes. */
+};
+
+/* -zswap: pool size limit in pages. */
+size_t zswap_max_pages;
+
+static struct lock zswap_lock; /* Protects everything below. */
+static struct hash entries;	   /* zswap_entry by slot. */
+static struct list unbuddied;  /* Pool pages with one free half. */
+static size_t pool_pages;	   /* Pages in the pool. */
+static size_t stored_cnt;	   /* Pages currently stored. */
+static size_t stored_bytes;	   /* Their compressed size. */
+static long long store_cnt;	   /* Pages stored. */
+static long long reject_cnt;   /* Pages that did not compress. */
+static long long full_cnt;	   /* Pages turned away by a full pool. */
+static long long load_cnt;	   /* Pages swapped in from the pool. */
+
+static size_t compress(const uint64_t *src, uint8_t *dst, size_t max);
+static void decompress(const uint8_t *src, size_t len, uint64_t *dst);
+static struct zswap_entry *find_entry(size_t slot);
+static struct zpage *zpage_alloc(size_t len, bool *last);
+static void zpage_free(struct zpage *zp, bool last);
+static uint8_t *entry_data(struct zswap_entry *e);
+static uint64_t entry_hash(const struct hash_elem *e, void *aux);
+static bool entry_less(const struct hash_elem *a, const struct hash_elem *b,
+					   void *aux);
+
+/* Initializes the compressed swap cache. */
+void zswap_init(void)
+{
+	lock_init(&zswap_lock);
+	hash_init(&entries, entry_hash, entry_less, NULL);
+	list_init(&unbuddied);
+}
+
+/* Tries to keep a compressed copy of the page at KVA as the
+ * contents of swap slot SLOT.  Returns false, keeping nothing, if
+ * zswap is off, the page does not compress well enough, or the
+ * pool is full; the page must then be written to disk. */
+bool zswap_store(size_t slot, const void *kva)
+{
+	static uint8_t buf[ZSWAP_MAX_LEN];
+	struct zswap_entry *e;
+	size_t len;
+	bool ok = false;
+
+	if (zswap_max_pages == 0)
+		return false;
+
+	e = malloc(sizeof *e);
+	if (e == NULL)
+		return false;
+
+	lock_acquire(&zswap_lock);
+	len = compress(kva, buf, sizeof buf);
+	if (len == 0)
+		reject_cnt++;
+	else if ((e->zp = zpage_alloc(len, &e->last)) == NULL)
+		full_cnt++;
+	else
+	{
+		e->slot = slot;
+		e->len = len;
+		memcpy(entry_data(e), buf, len);
+		hash_insert(&entries, &e->elem);
+		stored_cnt++;
+		stored_bytes += len;
+		store_cnt++;
+		ok = true;
+	}
+	lock_release(&zswap_lock);
+
+	if (!ok)
+		free(e);
+	return ok;
+}
+
+/* If swap slot SLOT is in the pool, decompresses it into the page
+ * at KVA and returns true.  Otherwise returns false. */
+bool zswap_load(size_t slot, void *kva)
+{
+	struct zswap_entry *e;
+
+	if (zswap_max_pages == 0)
+		return false;
+
+	lock_acquire(&zswap_lock);
+	e = find_entry(slot);
+	if (e != NULL)
+	{
+		decompress(entry_data(e), e->len, kva);
+		load_cnt++;
+	}
+	lock_release(&zswap_lock);
+	return e != NULL;
+}
+
+/* Returns true if swap slot SLOT is in the pool. */
+bool zswap_contains(size_t slot)
+{
+	bool found;
+
+	if (zswap_max_pages == 0)
+		return false;
+
+	lock_acquire(&zswap_lock);
+	found = find_entry(slot) != NULL;
+	lock_release(&zswap_lock);
+	return found;
+}
+
+/* Drops swap slot SLOT from the pool, if it is there, because the
+ * slot is being freed. */
+void zswap_invalidate(size_t slot)
+{
+	struct zswap_entry *e;
+
+	if (zswap_max_pages == 0)
+		return;
+
+	lock_acquire(&zswap_lock);
+	e = find_entry(slot);
+	if (e != NULL)
+	{
+		hash_delete(&entries, &e->elem);
+		zpage_free(e->zp, e->last);
+		stored_cnt--;
+		stored_bytes -= e->len;
+	}
+	lock_release(&zswap_lock);
+	free(e);
+}
+
+/* Prints compressed swap cache statistics. */
+void zswap_print_stats(void)
+{
+	if (zswap_max_pages == 0)
+		return;
+	printf("zswap: %zu of %zu pool pages hold %zu pages (%zu%% of original size)\n",
+		   pool_pages, zswap_max_pages, stored_cnt,
+		   stored_cnt > 0 ? stored_bytes * 100 / (stored_cnt * PGSIZE) : 0);
+	printf("zswap: %lld stored, %lld loaded, %lld incompressible, "
+		   "%lld pool full\n",
+		   store_cnt, load_cnt, reject_cnt, full_cnt);
+}
+
+/* Compresses the page at SRC into DST, which has room for MAX
+ * bytes.  Returns the compressed length, or 0 if it would not fit. */
+static size_t
+compress(const uint64_t *src, uint8_t *dst, size_t max)
+{
+	size_t i = 0, out = 0;
+
+	while (i < PAGE_WORDS)
+	{
+		uint64_t w = src[i];
+		size_t run = 1;
+
+		while (i + run < PAGE_WORDS && run < TOK_MAX_RUN && src[i + run] == w)
+			run++;
+
+		if (w == 0)
+		{
+			if (out + 1 > max)
+				return 0;
+			dst[out++] = TOK_ZERO | (run - 1);
+		}
+		else if (run > 1)
+		{
+			if (out + 1 + sizeof w > max)
+				return 0;
+			dst[out++] = TOK_REPEAT | (run - 1);
+			memcpy(dst + out, &w, sizeof w);
+			out += sizeof w;
+		}
+		else
+		{
+			/* Gather words up to the next run or zero word. */
+			while (i + run < PAGE_WORDS && run < TOK_MAX_RUN && src[i + run] != 0 && (i + run + 1 >= PAGE_WORDS || src[i + run + 1] != src[i + run]))
+				run++;
+			if (out + 1 + run * sizeof w > max)
+				return 0;
+			dst[out++] = TOK_LITERAL | (run - 1);
+			memcpy(dst + out, src + i, run * sizeof w);
+			out += run * sizeof w;
+		}
+		i += run;
+	}
+	return out;
+}
+
+/* Decompresses the LEN bytes at SRC, made by compress(), into the
+ * page at DST. */
+static void
+decompress(const uint8_t *src, size_t len, uint64_t *dst)
+{
+	const uint8_t *end = src + len;
+	size_t i = 0;
+
+	while (src < end)
+	{
+		uint8_t tok = *src++;
+		size_t run = (tok & ~TOK_TYPE) + 1;
+		uint64_t w;
+
+		ASSERT(i + run <= PAGE_WORDS);
+		switch (tok & TOK_TYPE)
+		{
+		case TOK_ZERO:
+			memset(dst + i, 0, run * sizeof w);
+			break;
+		case TOK_REPEAT:
+			memcpy(&w, src, sizeof w);
+			src += sizeof w;
+			for (size_t j = 0; j < run; j++)
+				dst[i + j] = w;
+			break;
+		case TOK_LITERAL:
+			memcpy(dst + i, src, run * sizeof w);
+			src += run * sizeof w;
+			break;
+		default:
+			NOT_REACHED();
+		}
+		i += run;
+	}
+	ASSERT(i == PAGE_WORDS);
+}
+
+/* Returns the entry for SLOT, or NULL.  zswap_lock must be held. */
+static struct zswap_entry *
+find_entry(size_t slot)
+{
+	struct zswap_entry key;
+	struct hash_elem *e;
+
+	key.slot = slot;
+	e = hash_find(&entries, &key.elem);
+	return e != NULL ? hash_entry(e, struct zswap_entry, elem) : NULL;
+}
+
+/* Finds room for LEN bytes in the pool, in a half-used pool page if
+ * one has enough space, else in a new page.  Stores in *LAST which
+ * end of the page was taken.  Returns NULL if the pool is full.
+ * zswap_lock must be held. */
+static struct zpage *
+zpage_alloc(size_t len, bool *last)
+{
+	struct list_elem *el;
+	struct zpage *zp;
+
+	for (el = list_begin(&unbuddied); el != list_end(&unbuddied); el = list_next(el))
+	{
+		zp = list_entry(el, struct zpage, elem);
+		if (zp->first_len + zp->last_len + len <= PGSIZE)
+		{
+			list_remove(el);
+			*last = zp->first_len != 0;
+			if (*last)
+				zp->last_len = len;
+			else
+				zp->first_len = len;
+			return zp;
+		}
+	}
+
+	if (pool_pages >= zswap_max_pages)
+		return NULL;
+	zp = malloc(sizeof *zp);
+	if (zp == NULL)
+		return NULL;
+	zp->kva = palloc_get_page(0);
+	if (zp->kva == NULL)
+	{
+		free(zp);
+		return NULL;
+	}
+	zp->first_len = len;
+	zp->last_len = 0;
+	list_push_back(&unbuddied, &zp->elem);
+	pool_pages++;
+	*last = false;
+	return zp;
+}
+
+/* Frees one half of ZP, and ZP itself once both are free.
+ * zswap_lock must be held. */
+static void
+zpage_free(struct zpage *zp, bool last)
+{
+	bool was_full = zp->first_len != 0 && zp->last_len != 0;
+
+	if (last)
+		zp->last_len = 0;
+	else
+		zp->first_len = 0;
+
+	if (zp->first_len == 0 && zp->last_len == 0)
+	{
+		list_remove(&zp->elem);
+		palloc_free_page(zp->kva);
+		free(zp);
+		pool_pages--;
+	}
+	else if (was_full)
+		list_push_back(&unbuddied, &zp->elem);
+}
+
+/* Returns where E's compressed data lives. */
+static uint8_t *
+entry_data(struct zswap_entry *e)
+{
+	return e->last ? e->zp->kva + PGSIZE - e->len : e->zp->kva;
+}
+
+static uint64_t
+entry_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+	const struct zswap_entry *entry = hash_entry(e, struct zswap_entry, elem);
+	return hash_bytes(&entry->slot, sizeof entry->slot);
+}
+
+static bool
+entry_less(const struct hash_elem *a, const struct hash_elem *b,
+		   void *aux UNUSED)
+{
+	return hash_entry(a, struct zswap_entry, elem)->slot < hash_entry(b, struct zswap_entry, elem)->slot;
+}